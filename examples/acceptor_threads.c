@@ -0,0 +1,134 @@
+/* One acceptor thread hands connections to worker threads, each running its own loop, picking the worker with
+ * the fewest connections. Workers answer with their number: curl localhost:3000
+ * ./acceptor_threads [workers] */
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(LIBUS_USE_IO_URING) && !defined(_WIN32)
+
+#include <pthread.h>
+
+#define PORT 3000
+#define MAX_WORKERS 64
+
+struct worker_t {
+    int number;
+    pthread_t thread;
+    struct us_loop_t *loop;
+    struct us_socket_context_t *context;
+};
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+struct us_socket_t *on_http_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    return s;
+}
+
+struct us_socket_t *on_http_data(struct us_socket_t *s, char *data, int length) {
+    struct worker_t *worker = (struct worker_t *) us_socket_context_ext(0, us_socket_context(0, s));
+
+    char response[128];
+    char body[32];
+    int body_length = snprintf(body, sizeof(body), "Served by worker %d\n", worker->number);
+    int response_length = snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n%s", body_length, body);
+    us_socket_write(0, s, response, response_length, 0);
+    return s;
+}
+
+struct us_socket_t *on_http_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_http_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_http_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_http_timeout(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+void *run_worker(void *arg) {
+    struct worker_t *worker = (struct worker_t *) arg;
+    us_loop_run(worker->loop);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int num_workers = argc > 1 ? atoi(argv[1]) : 4;
+    if (num_workers < 1 || num_workers > MAX_WORKERS) {
+        printf("Usage: acceptor_threads [1 to %d workers]\n", MAX_WORKERS);
+        return 0;
+    }
+
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+    struct us_acceptor_t *acceptor = us_create_acceptor(loop, LIBUS_ACCEPTOR_LEAST_CONNECTIONS);
+
+    /* Workers are set up before any loop runs */
+    struct worker_t *workers[MAX_WORKERS];
+    struct us_socket_context_options_t options = {};
+    for (int i = 0; i < num_workers; i++) {
+        struct us_loop_t *worker_loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+        struct us_socket_context_t *context = us_create_socket_context(0, worker_loop, sizeof(struct worker_t), options);
+        us_socket_context_on_open(0, context, on_http_open);
+        us_socket_context_on_data(0, context, on_http_data);
+        us_socket_context_on_writable(0, context, on_http_writable);
+        us_socket_context_on_close(0, context, on_http_close);
+        us_socket_context_on_end(0, context, on_http_end);
+        us_socket_context_on_timeout(0, context, on_http_timeout);
+
+        workers[i] = (struct worker_t *) us_socket_context_ext(0, context);
+        workers[i]->number = i;
+        workers[i]->loop = worker_loop;
+        workers[i]->context = context;
+        us_acceptor_add_worker(acceptor, 0, context, 0);
+    }
+
+    if (!us_acceptor_listen(acceptor, 0, PORT, 0)) {
+        printf("Failed to listen on port %d!\n", PORT);
+        return 1;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_create(&workers[i]->thread, 0, run_worker, workers[i]);
+    }
+
+    printf("Accepting on port %d for %d worker threads\n", PORT, num_workers);
+    us_loop_run(loop);
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i]->thread, 0);
+    }
+    us_acceptor_free(acceptor);
+    for (int i = 0; i < num_workers; i++) {
+        struct us_loop_t *worker_loop = workers[i]->loop;
+        us_socket_context_free(0, workers[i]->context);
+        us_loop_free(worker_loop);
+    }
+    us_loop_free(loop);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend or on Windows\n");
+}
+
+#endif
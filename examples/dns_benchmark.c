@@ -0,0 +1,245 @@
+/* Connects to host names served by a stub DNS server that answers after a delay, and measures how long the
+ * loop stalls meanwhile. The stub listens on 127.0.0.1:53, so run it in namespaces of its own:
+ * unshare -rmn sh -c 'ip link set lo up && echo "nameserver 127.0.0.1" > /tmp/stub_resolv.conf &&
+ *     mount --bind /tmp/stub_resolv.conf /etc/resolv.conf && ./dns_benchmark [connects] [delay ms] [hosts] [cache ttl]'
+ * Compare with a build made with WITH_ASYNC_DNS=0, and connects spread over fewer hosts with the DNS cache on */
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200809L
+
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(LIBUS_USE_IO_URING) && !defined(_WIN32)
+
+/* The stub server runs in a process of its own, on plain sockets */
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define PORT 3002
+#define MAX_PENDING_QUERIES 4096
+
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ll + ts.tv_nsec / 1000000;
+}
+
+/* Answers A queries with 127.0.0.1 and everything else with no records, delay_ms after receiving them */
+struct pending_query {
+    long long due;
+    struct sockaddr_in from;
+    int length;
+    unsigned char packet[512];
+};
+
+struct pending_query queries[MAX_PENDING_QUERIES];
+
+void run_stub_server(int fd, int delay_ms) {
+    int num_queries = 0;
+    while (1) {
+        int timeout = -1;
+        if (num_queries) {
+            timeout = (int) (queries[0].due - now_ms());
+            if (timeout < 0) {
+                timeout = 0;
+            }
+        }
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout) > 0 && num_queries < MAX_PENDING_QUERIES) {
+            struct pending_query *q = &queries[num_queries];
+            socklen_t from_length = sizeof(q->from);
+            q->length = (int) recvfrom(fd, q->packet, sizeof(q->packet) - 16, 0, (struct sockaddr *) &q->from, &from_length);
+            if (q->length > 12) {
+                q->due = now_ms() + delay_ms;
+                num_queries++;
+            }
+        }
+
+        /* Queries are due in the order they came in */
+        while (num_queries && queries[0].due <= now_ms()) {
+            struct pending_query *q = &queries[0];
+
+            /* The question ends with its name, then type and class */
+            int name_end = 12;
+            while (name_end < q->length && q->packet[name_end]) {
+                name_end += q->packet[name_end] + 1;
+            }
+            int type = (q->packet[name_end + 1] << 8) | q->packet[name_end + 2];
+            int length = name_end + 5;
+
+            q->packet[2] = 0x81;
+            q->packet[3] = 0x80;
+            q->packet[7] = 0;
+            q->packet[9] = q->packet[11] = 0;
+            if (type == 1) {
+                static const unsigned char answer[] = {0xc0, 0x0c, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 127, 0, 0, 1};
+                memcpy(q->packet + length, answer, sizeof(answer));
+                length += sizeof(answer);
+                q->packet[7] = 1;
+            }
+            sendto(fd, q->packet, length, 0, (struct sockaddr *) &q->from, sizeof(q->from));
+
+            memmove(queries, queries + 1, sizeof(struct pending_query) * --num_queries);
+        }
+    }
+}
+
+pid_t stub_pid;
+int connects, hosts, opened, failed;
+long long started, last_tick, max_stall;
+struct us_socket_context_t *client_context;
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+void check_done() {
+    if (opened + failed == connects) {
+        if (now_ms() - last_tick > max_stall) {
+            max_stall = now_ms() - last_tick;
+        }
+        printf("Connected %d (%d failed) in %lld ms, longest loop stall: %lld ms\n", opened, failed, now_ms() - started, max_stall);
+
+        struct us_dns_cache_stats_t stats;
+        us_loop_dns_cache_stats(us_socket_context_loop(0, client_context), &stats);
+        printf("DNS cache hits: %llu, misses: %llu\n", stats.hits, stats.misses);
+        kill(stub_pid, SIGTERM);
+        waitpid(stub_pid, NULL, 0);
+        exit(failed != 0);
+    }
+}
+
+struct us_socket_t *on_client_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    if (is_client) {
+        opened++;
+        check_done();
+    }
+    return s;
+}
+
+struct us_socket_t *on_client_connect_error(struct us_socket_t *s, int code) {
+    failed++;
+    check_done();
+    return s;
+}
+
+struct us_socket_t *on_data(struct us_socket_t *s, char *data, int length) {
+    return s;
+}
+
+struct us_socket_t *on_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_timeout(struct us_socket_t *s) {
+    return s;
+}
+
+/* Connects from within the loop so that a blocking resolver shows up as a stall */
+void on_tick(struct us_timer_t *t) {
+    long long now = now_ms();
+    if (last_tick && now - last_tick > max_stall) {
+        max_stall = now - last_tick;
+    }
+
+    if (!started) {
+        started = now;
+        for (int i = 0; i < connects; i++) {
+            char host[64];
+            snprintf(host, sizeof(host), "host%d.stub", i % hosts);
+            if (!us_socket_context_connect(0, client_context, host, PORT, NULL, 0, 0)) {
+                failed++;
+            }
+        }
+        check_done();
+    }
+
+    /* Issuing the connects counts towards the stall */
+    last_tick = now;
+}
+
+int main(int argc, char **argv) {
+    connects = argc > 1 ? atoi(argv[1]) : 100;
+    int delay_ms = argc > 2 ? atoi(argv[2]) : 50;
+    hosts = argc > 3 ? atoi(argv[3]) : connects;
+    int cache_ttl = argc > 4 ? atoi(argv[4]) : 0;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(53);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        printf("Could not bind the stub DNS server to 127.0.0.1:53, see the top of this file\n");
+        return 1;
+    }
+
+    printf("Connects: %d to %d hosts, resolver delay: %d ms, DNS cache TTL: %d s\n", connects, hosts, delay_ms, cache_ttl);
+    fflush(stdout);
+    stub_pid = fork();
+    if (stub_pid == 0) {
+        run_stub_server(fd, delay_ms);
+        return 0;
+    }
+    close(fd);
+
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+    us_loop_set_dns_cache(loop, cache_ttl, cache_ttl);
+    struct us_socket_context_options_t options = {};
+    client_context = us_create_socket_context(0, loop, 0, options);
+
+    us_socket_context_on_open(0, client_context, on_client_open);
+    us_socket_context_on_data(0, client_context, on_data);
+    us_socket_context_on_writable(0, client_context, on_writable);
+    us_socket_context_on_close(0, client_context, on_close);
+    us_socket_context_on_end(0, client_context, on_end);
+    us_socket_context_on_timeout(0, client_context, on_timeout);
+    us_socket_context_on_connect_error(0, client_context, on_client_connect_error);
+
+    if (!us_socket_context_listen(0, client_context, "127.0.0.1", PORT, 0, 0)) {
+        printf("Failed to listen!\n");
+        kill(stub_pid, SIGTERM);
+        return 1;
+    }
+
+    struct us_timer_t *tick = us_create_timer(loop, 0, 0);
+    us_timer_set(tick, on_tick, 1, 1);
+
+    us_loop_run(loop);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend or on Windows\n");
+}
+
+#endif
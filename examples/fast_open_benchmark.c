@@ -0,0 +1,148 @@
+/* Opens connections one after another, each sending one request from on_open and closing on the response, and
+ * measures the time from connect to response. With TCP Fast Open the request rides on the SYN, saving a round trip
+ * from the second connection on (the first fetches the cookie). Needs net.ipv4.tcp_fastopen = 3, and shows best
+ * over links with latency: tc qdisc add dev lo root netem delay 25ms. Count SYNs carrying data with
+ * nstat TcpExtTCPFastOpenActive TcpExtTCPFastOpenPassive
+ * ./fast_open_benchmark [fast open 0/1] [connections] */
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200809L
+
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef LIBUS_USE_IO_URING
+
+#define PORT 3003
+
+long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+int fast_open, connections, completed;
+long long connect_started, total_us;
+struct us_socket_context_t *client_context;
+struct us_listen_socket_t *listen_socket;
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+/* Server answers every request */
+struct us_socket_t *on_server_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    return s;
+}
+
+struct us_socket_t *on_server_data(struct us_socket_t *s, char *data, int length) {
+    us_socket_write(0, s, "pong", 4, 0);
+    return s;
+}
+
+struct us_socket_t *on_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_timeout(struct us_socket_t *s) {
+    return s;
+}
+
+void connect_next() {
+    if (completed == connections) {
+        printf("Average time to response: %lld us\n", total_us / connections);
+        us_listen_socket_close(0, listen_socket);
+        return;
+    }
+
+    connect_started = now_us();
+    if (!us_socket_context_connect(0, client_context, "127.0.0.1", PORT, NULL, fast_open ? LIBUS_CONNECT_FAST_OPEN : 0, 0)) {
+        printf("Could not connect\n");
+        exit(1);
+    }
+}
+
+/* The request is written right away, so with fast open it goes with the SYN */
+struct us_socket_t *on_client_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    us_socket_write(0, s, "ping", 4, 0);
+    return s;
+}
+
+struct us_socket_t *on_client_data(struct us_socket_t *s, char *data, int length) {
+    total_us += now_us() - connect_started;
+    completed++;
+    us_socket_close(0, s, 0, NULL);
+    connect_next();
+    return s;
+}
+
+struct us_socket_t *on_client_connect_error(struct us_socket_t *s, int code) {
+    printf("Could not connect to the server\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    fast_open = argc > 1 ? atoi(argv[1]) : 1;
+    connections = argc > 2 ? atoi(argv[2]) : 1000;
+    printf("Fast open: %s, connections: %d\n", fast_open ? "yes" : "no", connections);
+
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+
+    struct us_socket_context_options_t options = {};
+    struct us_socket_context_t *server_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, server_context, on_server_open);
+    us_socket_context_on_data(0, server_context, on_server_data);
+    us_socket_context_on_writable(0, server_context, on_writable);
+    us_socket_context_on_close(0, server_context, on_close);
+    us_socket_context_on_end(0, server_context, on_end);
+    us_socket_context_on_timeout(0, server_context, on_timeout);
+
+    client_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, client_context, on_client_open);
+    us_socket_context_on_data(0, client_context, on_client_data);
+    us_socket_context_on_writable(0, client_context, on_writable);
+    us_socket_context_on_close(0, client_context, on_close);
+    us_socket_context_on_end(0, client_context, on_end);
+    us_socket_context_on_timeout(0, client_context, on_timeout);
+    us_socket_context_on_connect_error(0, client_context, on_client_connect_error);
+
+    listen_socket = us_socket_context_listen(0, server_context, "127.0.0.1", PORT, LIBUS_LISTEN_FAST_OPEN, 0);
+    if (!listen_socket) {
+        printf("Failed to listen!\n");
+        return 1;
+    }
+
+    connect_next();
+    us_loop_run(loop);
+
+    us_socket_context_free(0, client_context);
+    us_socket_context_free(0, server_context);
+    us_loop_free(loop);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend\n");
+}
+
+#endif
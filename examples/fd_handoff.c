@@ -0,0 +1,208 @@
+/* An acceptor process hands accepted connections to worker processes over unix sockets (SCM_RIGHTS), which
+ * serve them directly, with no proxy hop in between. Workers answer with their pid: curl localhost:3000
+ * ./fd_handoff [workers] */
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(LIBUS_USE_IO_URING) && !defined(_WIN32)
+
+#include <unistd.h>
+
+#define PORT 3000
+#define HANDOFF_PATH "/tmp/us_fd_handoff.sock"
+#define MAX_WORKERS 64
+
+struct us_socket_t *workers[MAX_WORKERS];
+int num_workers, next_worker;
+struct us_socket_context_t *http_context;
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+/* Served by workers, or by the acceptor while it has none */
+struct us_socket_t *on_http_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    return s;
+}
+
+struct us_socket_t *on_http_data(struct us_socket_t *s, char *data, int length) {
+    char response[128];
+    char body[32];
+    int body_length = snprintf(body, sizeof(body), "Served by %d\n", (int) getpid());
+    int response_length = snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n%s", body_length, body);
+    us_socket_write(0, s, response, response_length, 0);
+    return s;
+}
+
+struct us_socket_t *on_http_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_http_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_http_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_http_timeout(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+void set_http_handlers(struct us_socket_context_t *context) {
+    us_socket_context_on_open(0, context, on_http_open);
+    us_socket_context_on_data(0, context, on_http_data);
+    us_socket_context_on_writable(0, context, on_http_writable);
+    us_socket_context_on_close(0, context, on_http_close);
+    us_socket_context_on_end(0, context, on_http_end);
+    us_socket_context_on_timeout(0, context, on_http_timeout);
+}
+
+/* Acceptor: passes every accepted descriptor on to the next worker before anything is read from it */
+LIBUS_SOCKET_DESCRIPTOR on_http_pre_open(LIBUS_SOCKET_DESCRIPTOR fd) {
+    if (!num_workers) {
+        return fd;
+    }
+
+    struct us_socket_t *worker = workers[next_worker++ % num_workers];
+    if (!us_socket_write_fds(0, worker, "c", 1, &fd, 1)) {
+        return fd;
+    }
+
+    /* The worker holds its own copy now */
+    close(fd);
+    return -1;
+}
+
+struct us_socket_t *on_worker_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    if (num_workers == MAX_WORKERS) {
+        return us_socket_close(0, s, 0, NULL);
+    }
+    workers[num_workers++] = s;
+    return s;
+}
+
+struct us_socket_t *on_worker_close(struct us_socket_t *s, int code, void *reason) {
+    for (int i = 0; i < num_workers; i++) {
+        if (workers[i] == s) {
+            workers[i] = workers[--num_workers];
+            break;
+        }
+    }
+    return s;
+}
+
+/* Worker: adopts what the acceptor passes, the byte that carried it means nothing */
+struct us_socket_t *on_handoff_fds(struct us_socket_t *s, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds) {
+    for (int i = 0; i < num_fds; i++) {
+        if (!us_adopt_received_socket(0, http_context, fds[i], 0, NULL, 0)) {
+            close(fds[i]);
+        }
+    }
+    return s;
+}
+
+struct us_socket_t *on_handoff_data(struct us_socket_t *s, char *data, int length) {
+    return s;
+}
+
+struct us_socket_t *on_handoff_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_handoff_connect_error(struct us_socket_t *s, int code) {
+    printf("Worker %d could not reach the acceptor\n", (int) getpid());
+    return s;
+}
+
+int run_worker() {
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+
+    struct us_socket_context_options_t options = {};
+    http_context = us_create_socket_context(0, loop, 0, options);
+    set_http_handlers(http_context);
+
+    struct us_socket_context_t *handoff_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, handoff_context, on_http_open);
+    us_socket_context_on_data(0, handoff_context, on_handoff_data);
+    us_socket_context_on_writable(0, handoff_context, on_http_writable);
+    us_socket_context_on_close(0, handoff_context, on_http_close);
+    us_socket_context_on_end(0, handoff_context, on_handoff_end);
+    us_socket_context_on_timeout(0, handoff_context, on_http_timeout);
+    us_socket_context_on_connect_error(0, handoff_context, on_handoff_connect_error);
+    us_socket_context_on_fds(0, handoff_context, on_handoff_fds);
+
+    if (!us_socket_context_connect_unix(0, handoff_context, HANDOFF_PATH, 0, 0)) {
+        printf("Worker %d could not reach the acceptor\n", (int) getpid());
+        return 1;
+    }
+
+    us_loop_run(loop);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int workers_to_start = argc > 1 ? atoi(argv[1]) : 4;
+
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+
+    struct us_socket_context_options_t options = {};
+    struct us_socket_context_t *handoff_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, handoff_context, on_worker_open);
+    us_socket_context_on_data(0, handoff_context, on_handoff_data);
+    us_socket_context_on_writable(0, handoff_context, on_http_writable);
+    us_socket_context_on_close(0, handoff_context, on_worker_close);
+    us_socket_context_on_end(0, handoff_context, on_handoff_end);
+    us_socket_context_on_timeout(0, handoff_context, on_http_timeout);
+
+    unlink(HANDOFF_PATH);
+    if (!us_socket_context_listen_unix(0, handoff_context, HANDOFF_PATH, 0, 0)) {
+        printf("Failed to listen on %s!\n", HANDOFF_PATH);
+        return 1;
+    }
+
+    http_context = us_create_socket_context(0, loop, 0, options);
+    set_http_handlers(http_context);
+    us_socket_context_on_pre_open(0, http_context, on_http_pre_open);
+
+    if (!us_socket_context_listen(0, http_context, 0, PORT, 0, 0)) {
+        printf("Failed to listen on port %d!\n", PORT);
+        return 1;
+    }
+
+    /* Workers start their own loops, only the acceptor polls the listen sockets they inherit */
+    fflush(stdout);
+    for (int i = 0; i < workers_to_start; i++) {
+        if (fork() == 0) {
+            return run_worker();
+        }
+    }
+
+    printf("Acceptor %d handing off connections on port %d to %d workers\n", (int) getpid(), PORT, workers_to_start);
+    us_loop_run(loop);
+
+    us_socket_context_free(0, http_context);
+    us_socket_context_free(0, handoff_context);
+    us_loop_free(loop);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend or on Windows\n");
+}
+
+#endif
@@ -0,0 +1,172 @@
+/* Zero-downtime restarts: a new instance asks the running one for its listen socket over a unix socket, and
+ * accepts on it from then on, while the old instance stops accepting and drains its connections. Connections
+ * queued meanwhile are never dropped as the listen socket stays open throughout. Start one instance, keep
+ * curl localhost:3000 busy, then start another: ./hot_restart */
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(LIBUS_USE_IO_URING) && !defined(_WIN32)
+
+#include <unistd.h>
+
+#define PORT 3000
+#define CONTROL_PATH "/tmp/us_hot_restart.sock"
+/* Seconds the old instance gives its connections to finish */
+#define DRAIN_SECONDS 10
+
+struct us_socket_context_t *http_context, *control_context;
+struct us_listen_socket_t *http_listen_socket, *control_listen_socket;
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+struct us_socket_t *on_http_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    return s;
+}
+
+struct us_socket_t *on_http_data(struct us_socket_t *s, char *data, int length) {
+    char response[128];
+    char body[32];
+    int body_length = snprintf(body, sizeof(body), "Served by %d\n", (int) getpid());
+    int response_length = snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n%s", body_length, body);
+    us_socket_write(0, s, response, response_length, 0);
+    return s;
+}
+
+struct us_socket_t *on_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_timeout(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+/* Takes over the control path so that the next instance finds this one */
+void serve_control() {
+    control_listen_socket = us_socket_context_listen_unix(0, control_context, CONTROL_PATH, 0, 0);
+    if (!control_listen_socket) {
+        printf("Failed to listen on %s!\n", CONTROL_PATH);
+        exit(1);
+    }
+}
+
+void start_fresh() {
+    http_listen_socket = us_socket_context_listen(0, http_context, 0, PORT, 0, 0);
+    if (!http_listen_socket) {
+        printf("Failed to listen on port %d!\n", PORT);
+        exit(1);
+    }
+    printf("Instance %d listening on port %d\n", (int) getpid(), PORT);
+    serve_control();
+}
+
+/* Old instance: a new one connected, hand it the listen socket and step down. The new one hangs up once it
+ * took over, closing first could have its connect fail before it read anything */
+struct us_socket_t *on_control_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    if (is_client) {
+        return s;
+    }
+
+    LIBUS_SOCKET_DESCRIPTOR fd = us_listen_socket_fd(http_listen_socket);
+    if (!us_socket_write_fds(0, s, "l", 1, &fd, 1)) {
+        return us_socket_close(0, s, 0, NULL);
+    }
+
+    printf("Instance %d handed over, draining\n", (int) getpid());
+    us_listen_socket_close(0, control_listen_socket);
+    us_socket_context_drain(0, http_context, DRAIN_SECONDS);
+    return s;
+}
+
+/* New instance: accept on what the old one passed */
+struct us_socket_t *on_control_fds(struct us_socket_t *s, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds) {
+    for (int i = 0; i < num_fds; i++) {
+        if (!http_listen_socket) {
+            http_listen_socket = us_socket_context_adopt_listen_socket(0, http_context, fds[i], 0);
+        }
+        if (http_listen_socket && us_listen_socket_fd(http_listen_socket) != fds[i]) {
+            close(fds[i]);
+        }
+    }
+
+    if (!http_listen_socket) {
+        printf("Got no listen socket from the running instance\n");
+        exit(1);
+    }
+    printf("Instance %d took over port %d\n", (int) getpid(), PORT);
+    serve_control();
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_control_data(struct us_socket_t *s, char *data, int length) {
+    return s;
+}
+
+/* Nothing is running yet */
+struct us_socket_t *on_control_connect_error(struct us_socket_t *s, int code) {
+    start_fresh();
+    return s;
+}
+
+int main() {
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+
+    struct us_socket_context_options_t options = {};
+    http_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, http_context, on_http_open);
+    us_socket_context_on_data(0, http_context, on_http_data);
+    us_socket_context_on_writable(0, http_context, on_writable);
+    us_socket_context_on_close(0, http_context, on_close);
+    us_socket_context_on_end(0, http_context, on_end);
+    us_socket_context_on_timeout(0, http_context, on_timeout);
+
+    control_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, control_context, on_control_open);
+    us_socket_context_on_data(0, control_context, on_control_data);
+    us_socket_context_on_writable(0, control_context, on_writable);
+    us_socket_context_on_close(0, control_context, on_close);
+    us_socket_context_on_end(0, control_context, on_end);
+    us_socket_context_on_timeout(0, control_context, on_timeout);
+    us_socket_context_on_connect_error(0, control_context, on_control_connect_error);
+    us_socket_context_on_fds(0, control_context, on_control_fds);
+
+    if (!us_socket_context_connect_unix(0, control_context, CONTROL_PATH, 0, 0)) {
+        start_fresh();
+    }
+
+    us_loop_run(loop);
+    printf("Instance %d done\n", (int) getpid());
+
+    us_socket_context_free(0, control_context);
+    us_socket_context_free(0, http_context);
+    us_loop_free(loop);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend or on Windows\n");
+}
+
+#endif
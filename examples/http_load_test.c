@@ -12,6 +12,9 @@ char *host;
 int port;
 int connections;
 
+/* Rate of SYNs while ramping up, so that the server's accept queue keeps up */
+#define CONNECTS_PER_MS 100
+
 int responses;
 
 struct http_socket {
@@ -72,9 +75,8 @@ struct us_socket_t *on_http_socket_open(struct us_socket_t *s, int is_client, ch
     /* Send a request */
     us_socket_write(SSL, s, request, sizeof(request) - 1, 0);
 
-    if (--connections) {
-        us_socket_context_connect(SSL, us_socket_context(SSL, s), host, port, NULL, 0, sizeof(struct http_socket));
-    } else {
+    /* The last connection to open starts the benchmark */
+    if (!--connections) {
         printf("Running benchmark now...\n");
 
         us_socket_timeout(SSL, s, LIBUS_TIMEOUT_GRANULARITY);
@@ -111,8 +113,8 @@ struct us_socket_t *on_http_socket_connect_error(struct us_socket_t *s, int code
 int main(int argc, char **argv) {
 
     /* Parse host and port */
-    if (argc != 4) {
-        printf("Usage: connections host port\n");
+    if (argc < 4) {
+        printf("Usage: connections host port [source hosts...]\n");
         return 0;
     }
 
@@ -146,8 +148,12 @@ int main(int argc, char **argv) {
     us_socket_context_on_end(SSL, http_context, on_http_socket_end);
     us_socket_context_on_connect_error(SSL, http_context, on_http_socket_connect_error);
 
-    /* Start making HTTP connections */
-    if (!us_socket_context_connect(SSL, http_context, host, port, NULL, 0, sizeof(struct http_socket))) {
+    /* Start making HTTP connections, spread across source hosts if given to get past 64k per source */
+    struct us_connect_many_options_t connect_options = {};
+    connect_options.source_hosts = (const char **) argv + 4;
+    connect_options.source_host_count = argc - 4;
+    connect_options.per_tick = CONNECTS_PER_MS;
+    if (!us_socket_context_connect_many(SSL, http_context, host, port, connections, sizeof(struct http_socket), connect_options)) {
         printf("Cannot connect to server\n");
     }
 
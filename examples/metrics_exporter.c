@@ -0,0 +1,87 @@
+/* A tiny HTTP server on port 3000 exporting its own metrics on port 9100 for Prometheus to scrape.
+ * Build the library with WITH_METRICS=1 and WITH_CALLBACK_TIMING=1, then: curl localhost:9100/metrics */
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PORT 3000
+#define METRICS_PORT 9100
+
+char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 12\r\n\r\nHello world!";
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+struct us_socket_t *on_http_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    us_socket_timeout(0, s, 30);
+    return s;
+}
+
+struct us_socket_t *on_http_data(struct us_socket_t *s, char *data, int length) {
+    us_socket_write(0, s, response, sizeof(response) - 1, 0);
+    us_socket_timeout(0, s, 30);
+    return s;
+}
+
+struct us_socket_t *on_http_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_http_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_http_end(struct us_socket_t *s) {
+    us_socket_shutdown(0, s);
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_http_timeout(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+int main() {
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+
+    struct us_socket_context_options_t options = {};
+    struct us_socket_context_t *http_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, http_context, on_http_open);
+    us_socket_context_on_data(0, http_context, on_http_data);
+    us_socket_context_on_writable(0, http_context, on_http_writable);
+    us_socket_context_on_close(0, http_context, on_http_close);
+    us_socket_context_on_end(0, http_context, on_http_end);
+    us_socket_context_on_timeout(0, http_context, on_http_timeout);
+
+    if (!us_socket_context_listen(0, http_context, 0, PORT, 0, 0)) {
+        printf("Failed to listen on port %d!\n", PORT);
+        return 1;
+    }
+
+    /* More loops on other threads would be added the same way, all summed up in one scrape */
+    struct us_metrics_exporter_t *exporter = us_create_metrics_exporter(loop, 0, METRICS_PORT, 0);
+    if (!exporter) {
+        printf("Failed to listen on port %d!\n", METRICS_PORT);
+        return 1;
+    }
+    us_metrics_exporter_add_loop(exporter, loop);
+    us_metrics_exporter_add_context(exporter, 0, http_context, "http");
+
+    printf("Serving on port %d, metrics on port %d\n", PORT, METRICS_PORT);
+    us_loop_run(loop);
+
+    us_metrics_exporter_free(exporter);
+    us_socket_context_free(0, http_context);
+    us_loop_free(loop);
+    return 0;
+}
@@ -0,0 +1,267 @@
+/* Measures how bulk uploaders affect the latency of small request/response clients served by the same loop.
+ * Run it with and without a read quota: read_fairness_benchmark [read quota bytes] [bulk clients] [small clients] */
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200809L
+
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(LIBUS_USE_IO_URING) && !defined(_WIN32)
+
+/* The server and the clients live in different processes so that they do not share a loop */
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define PORT 3001
+#define DURATION_SECONDS 5
+#define SMALL_MESSAGE_SIZE 64
+#define BULK_CHUNK_SIZE (64 * 1024)
+#define MAX_SAMPLES (1 << 22)
+
+/* Clients announce what they are with their first byte */
+#define TYPE_SMALL 'S'
+#define TYPE_BULK 'B'
+
+struct server_socket {
+    char type;
+};
+
+struct client_socket {
+    char type;
+    int received;
+    long long sent_at;
+};
+
+char bulk_chunk[BULK_CHUNK_SIZE];
+char small_message[SMALL_MESSAGE_SIZE];
+
+/* Round-trip times in microseconds */
+long long *samples;
+int num_samples;
+long long bulk_bytes;
+
+long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+/* Server: echoes small messages, swallows bulk data */
+struct us_socket_t *on_server_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    struct server_socket *ss = (struct server_socket *) us_socket_ext(0, s);
+    ss->type = 0;
+    return s;
+}
+
+struct us_socket_t *on_server_data(struct us_socket_t *s, char *data, int length) {
+    struct server_socket *ss = (struct server_socket *) us_socket_ext(0, s);
+    if (!ss->type) {
+        ss->type = data[0];
+    }
+
+    if (ss->type == TYPE_SMALL) {
+        us_socket_write(0, s, data, length, 0);
+    }
+    return s;
+}
+
+struct us_socket_t *on_server_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_server_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_server_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_server_timeout(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_context_t *server_context;
+struct us_listen_socket_t *listen_socket;
+
+void on_server_done(struct us_timer_t *t) {
+    us_listen_socket_close(0, listen_socket);
+    us_socket_context_close(0, server_context);
+    us_timer_close(t);
+}
+
+/* Clients */
+struct us_socket_t *send_small(struct us_socket_t *s) {
+    struct client_socket *cs = (struct client_socket *) us_socket_ext(0, s);
+    cs->received = 0;
+    cs->sent_at = now_us();
+    us_socket_write(0, s, small_message, SMALL_MESSAGE_SIZE, 0);
+    return s;
+}
+
+struct us_socket_t *on_client_writable(struct us_socket_t *s) {
+    struct client_socket *cs = (struct client_socket *) us_socket_ext(0, s);
+    if (cs->type == TYPE_BULK) {
+        int written;
+        while ((written = us_socket_write(0, s, bulk_chunk, BULK_CHUNK_SIZE, 0)) > 0) {
+            bulk_bytes += written;
+            if (written < BULK_CHUNK_SIZE) {
+                break;
+            }
+        }
+    }
+    return s;
+}
+
+struct us_socket_t *on_client_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    struct client_socket *cs = (struct client_socket *) us_socket_ext(0, s);
+    if (cs->type == TYPE_SMALL) {
+        return send_small(s);
+    }
+    return on_client_writable(s);
+}
+
+struct us_socket_t *on_client_data(struct us_socket_t *s, char *data, int length) {
+    struct client_socket *cs = (struct client_socket *) us_socket_ext(0, s);
+    cs->received += length;
+    if (cs->received >= SMALL_MESSAGE_SIZE) {
+        if (num_samples < MAX_SAMPLES) {
+            samples[num_samples++] = now_us() - cs->sent_at;
+        }
+        return send_small(s);
+    }
+    return s;
+}
+
+struct us_socket_t *on_client_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_client_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_client_timeout(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_client_connect_error(struct us_socket_t *s, int code) {
+    printf("Could not connect to the server\n");
+    exit(1);
+}
+
+int compare_samples(const void *a, const void *b) {
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+void on_client_done(struct us_timer_t *t) {
+    qsort(samples, num_samples, sizeof(long long), compare_samples);
+    if (num_samples) {
+        printf("Small requests: %d (%.0f req/s)\n", num_samples, (double) num_samples / DURATION_SECONDS);
+        printf("Latency p50: %lld us, p99: %lld us, p99.9: %lld us, max: %lld us\n", samples[num_samples / 2],
+            samples[(long long) num_samples * 99 / 100], samples[(long long) num_samples * 999 / 1000], samples[num_samples - 1]);
+    } else {
+        printf("No small request completed!\n");
+    }
+    printf("Bulk upload: %.1f MB/s\n", (double) bulk_bytes / DURATION_SECONDS / (1024 * 1024));
+    exit(0);
+}
+
+int run_clients(int bulk_clients, int small_clients) {
+    samples = malloc(sizeof(long long) * MAX_SAMPLES);
+    memset(bulk_chunk, TYPE_BULK, BULK_CHUNK_SIZE);
+    memset(small_message, TYPE_SMALL, SMALL_MESSAGE_SIZE);
+
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+    struct us_socket_context_options_t options = {};
+    struct us_socket_context_t *context = us_create_socket_context(0, loop, 0, options);
+
+    us_socket_context_on_open(0, context, on_client_open);
+    us_socket_context_on_data(0, context, on_client_data);
+    us_socket_context_on_writable(0, context, on_client_writable);
+    us_socket_context_on_close(0, context, on_client_close);
+    us_socket_context_on_end(0, context, on_client_end);
+    us_socket_context_on_timeout(0, context, on_client_timeout);
+    us_socket_context_on_connect_error(0, context, on_client_connect_error);
+
+    for (int i = 0; i < bulk_clients + small_clients; i++) {
+        struct us_socket_t *s = us_socket_context_connect(0, context, "127.0.0.1", PORT, NULL, 0, sizeof(struct client_socket));
+        struct client_socket *cs = (struct client_socket *) us_socket_ext(0, s);
+        cs->type = i < bulk_clients ? TYPE_BULK : TYPE_SMALL;
+    }
+
+    struct us_timer_t *done = us_create_timer(loop, 0, 0);
+    us_timer_set(done, on_client_done, DURATION_SECONDS * 1000, 0);
+
+    us_loop_run(loop);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned int read_quota = argc > 1 ? (unsigned int) atoi(argv[1]) : 0;
+    int bulk_clients = argc > 2 ? atoi(argv[2]) : 8;
+    int small_clients = argc > 3 ? atoi(argv[3]) : 100;
+
+    printf("Read quota: %u bytes, bulk clients: %d, small clients: %d\n", read_quota, bulk_clients, small_clients);
+
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+    us_loop_set_read_quota(loop, read_quota);
+
+    struct us_socket_context_options_t options = {};
+    server_context = us_create_socket_context(0, loop, 0, options);
+
+    us_socket_context_on_open(0, server_context, on_server_open);
+    us_socket_context_on_data(0, server_context, on_server_data);
+    us_socket_context_on_writable(0, server_context, on_server_writable);
+    us_socket_context_on_close(0, server_context, on_server_close);
+    us_socket_context_on_end(0, server_context, on_server_end);
+    us_socket_context_on_timeout(0, server_context, on_server_timeout);
+
+    listen_socket = us_socket_context_listen(0, server_context, "127.0.0.1", PORT, 0, sizeof(struct server_socket));
+    if (!listen_socket) {
+        printf("Failed to listen!\n");
+        return 1;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        return run_clients(bulk_clients, small_clients);
+    }
+
+    /* Stop serving once the clients are done */
+    struct us_timer_t *done = us_create_timer(loop, 0, 0);
+    us_timer_set(done, on_server_done, (DURATION_SECONDS + 1) * 1000, 0);
+
+    us_loop_run(loop);
+    us_socket_context_free(0, server_context);
+    us_loop_free(loop);
+
+    waitpid(pid, NULL, 0);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend or on Windows\n");
+}
+
+#endif
@@ -0,0 +1,198 @@
+/* Small-message echo workload for comparing receive buffer configurations. Compare cache misses of the server with
+ * perf stat --no-inherit -e cache-misses,L1-dcache-load-misses ./recv_buffer_benchmark [recv buffer length] [adaptive 0/1] */
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(LIBUS_USE_IO_URING) && !defined(_WIN32)
+
+/* The server and the clients live in different processes so that they do not share a loop */
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define PORT 3001
+#define DURATION_SECONDS 5
+#define CLIENTS 200
+#define MESSAGE_SIZE 512
+
+struct client_socket {
+    int received;
+};
+
+char message[MESSAGE_SIZE];
+long long requests;
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+/* Server echoes everything */
+struct us_socket_t *on_server_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    return s;
+}
+
+struct us_socket_t *on_server_data(struct us_socket_t *s, char *data, int length) {
+    us_socket_write(0, s, data, length, 0);
+    return s;
+}
+
+struct us_socket_t *on_server_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_server_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_server_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_server_timeout(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_context_t *server_context;
+struct us_listen_socket_t *listen_socket;
+
+void on_server_done(struct us_timer_t *t) {
+    us_listen_socket_close(0, listen_socket);
+    us_socket_context_close(0, server_context);
+    us_timer_close(t);
+}
+
+/* Clients keep one message in flight each */
+struct us_socket_t *send_message(struct us_socket_t *s) {
+    struct client_socket *cs = (struct client_socket *) us_socket_ext(0, s);
+    cs->received = 0;
+    us_socket_write(0, s, message, MESSAGE_SIZE, 0);
+    return s;
+}
+
+struct us_socket_t *on_client_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    return send_message(s);
+}
+
+struct us_socket_t *on_client_data(struct us_socket_t *s, char *data, int length) {
+    struct client_socket *cs = (struct client_socket *) us_socket_ext(0, s);
+    cs->received += length;
+    if (cs->received >= MESSAGE_SIZE) {
+        requests++;
+        return send_message(s);
+    }
+    return s;
+}
+
+struct us_socket_t *on_client_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_client_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_client_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_client_timeout(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_client_connect_error(struct us_socket_t *s, int code) {
+    printf("Could not connect to the server\n");
+    exit(1);
+}
+
+void on_client_done(struct us_timer_t *t) {
+    printf("Requests per second: %.0f\n", (double) requests / DURATION_SECONDS);
+    exit(0);
+}
+
+int run_clients() {
+    memset(message, 'x', MESSAGE_SIZE);
+
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+    struct us_socket_context_options_t options = {};
+    struct us_socket_context_t *context = us_create_socket_context(0, loop, 0, options);
+
+    us_socket_context_on_open(0, context, on_client_open);
+    us_socket_context_on_data(0, context, on_client_data);
+    us_socket_context_on_writable(0, context, on_client_writable);
+    us_socket_context_on_close(0, context, on_client_close);
+    us_socket_context_on_end(0, context, on_client_end);
+    us_socket_context_on_timeout(0, context, on_client_timeout);
+    us_socket_context_on_connect_error(0, context, on_client_connect_error);
+
+    for (int i = 0; i < CLIENTS; i++) {
+        us_socket_context_connect(0, context, "127.0.0.1", PORT, NULL, 0, sizeof(struct client_socket));
+    }
+
+    struct us_timer_t *done = us_create_timer(loop, 0, 0);
+    us_timer_set(done, on_client_done, DURATION_SECONDS * 1000, 0);
+
+    us_loop_run(loop);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct us_loop_options_t loop_options = {};
+    loop_options.recv_buffer_length = argc > 1 ? atoi(argv[1]) : 0;
+    loop_options.adaptive_read_size = argc > 2 ? atoi(argv[2]) : 0;
+
+    printf("Receive buffer: %d bytes, adaptive read size: %s\n", loop_options.recv_buffer_length ? loop_options.recv_buffer_length : LIBUS_RECV_BUFFER_LENGTH,
+        loop_options.adaptive_read_size ? "yes" : "no");
+
+    struct us_loop_t *loop = us_create_loop_with_options(0, on_wakeup, on_pre, on_post, 0, loop_options);
+
+    struct us_socket_context_options_t options = {};
+    server_context = us_create_socket_context(0, loop, 0, options);
+
+    us_socket_context_on_open(0, server_context, on_server_open);
+    us_socket_context_on_data(0, server_context, on_server_data);
+    us_socket_context_on_writable(0, server_context, on_server_writable);
+    us_socket_context_on_close(0, server_context, on_server_close);
+    us_socket_context_on_end(0, server_context, on_server_end);
+    us_socket_context_on_timeout(0, server_context, on_server_timeout);
+
+    listen_socket = us_socket_context_listen(0, server_context, "127.0.0.1", PORT, 0, 0);
+    if (!listen_socket) {
+        printf("Failed to listen!\n");
+        return 1;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        return run_clients();
+    }
+
+    /* Stop serving once the clients are done */
+    struct us_timer_t *done = us_create_timer(loop, 0, 0);
+    us_timer_set(done, on_server_done, (DURATION_SECONDS + 1) * 1000, 0);
+
+    us_loop_run(loop);
+    us_socket_context_free(0, server_context);
+    us_loop_free(loop);
+
+    waitpid(pid, NULL, 0);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend or on Windows\n");
+}
+
+#endif
@@ -0,0 +1,241 @@
+/* Compares tail latency of new connections between a SO_REUSEPORT listen socket per loop and one listen socket
+ * shared by all loops (us_socket_context_share_listen_socket), while one of the loops is slowed down.
+ * ./shared_listen_benchmark [loops] [slow ms per request] [seconds per mode] */
+#include <libusockets.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(LIBUS_USE_IO_URING) && !defined(_WIN32)
+
+#include <pthread.h>
+#include <time.h>
+
+#define PORT 3000
+#define MAX_LOOPS 64
+/* Clients connecting at any time */
+#define CONCURRENCY 32
+#define MAX_SAMPLES 1000000
+
+struct server_t {
+    pthread_t thread;
+    struct us_loop_t *loop;
+    struct us_socket_context_t *context;
+    int slow_ms;
+};
+
+struct client_socket_t {
+    long long started_ns;
+};
+
+char request[] = "GET / HTTP/1.1\r\n\r\n";
+char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+
+long long *samples;
+int num_samples;
+int running;
+struct us_socket_context_t *client_context;
+
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void on_wakeup(struct us_loop_t *loop) {
+
+}
+
+void on_pre(struct us_loop_t *loop) {
+
+}
+
+void on_post(struct us_loop_t *loop) {
+
+}
+
+/* Servers stop on a wakeup from the main thread */
+void on_server_wakeup(struct us_loop_t *loop) {
+    struct server_t *server = *(struct server_t **) us_loop_ext(loop);
+    us_socket_context_close(0, server->context);
+}
+
+struct us_socket_t *on_server_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    return s;
+}
+
+struct us_socket_t *on_server_data(struct us_socket_t *s, char *data, int length) {
+    struct server_t *server = *(struct server_t **) us_loop_ext(us_socket_context_loop(0, us_socket_context(0, s)));
+
+    /* Stands in for a loop stalled by some heavy request */
+    if (server->slow_ms) {
+        struct timespec slow = {server->slow_ms / 1000, (server->slow_ms % 1000) * 1000000L};
+        nanosleep(&slow, 0);
+    }
+    us_socket_write(0, s, response, sizeof(response) - 1, 0);
+    return s;
+}
+
+struct us_socket_t *on_writable(struct us_socket_t *s) {
+    return s;
+}
+
+struct us_socket_t *on_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+struct us_socket_t *on_end(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_timeout(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+void client_connect() {
+    struct us_socket_t *s = us_socket_context_connect(0, client_context, "127.0.0.1", PORT, 0, 0, sizeof(struct client_socket_t));
+    if (s) {
+        ((struct client_socket_t *) us_socket_ext(0, s))->started_ns = now_ns();
+    }
+}
+
+struct us_socket_t *on_client_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    us_socket_write(0, s, request, sizeof(request) - 1, 0);
+    return s;
+}
+
+/* A sample is connect and request to response, then the client goes again with a new connection */
+struct us_socket_t *on_client_data(struct us_socket_t *s, char *data, int length) {
+    if (num_samples < MAX_SAMPLES) {
+        samples[num_samples++] = now_ns() - ((struct client_socket_t *) us_socket_ext(0, s))->started_ns;
+    }
+    s = us_socket_close(0, s, 0, NULL);
+    if (running) {
+        client_connect();
+    }
+    return s;
+}
+
+struct us_socket_t *on_client_connect_error(struct us_socket_t *s, int code) {
+    if (running) {
+        client_connect();
+    }
+    return s;
+}
+
+void on_client_done(struct us_timer_t *t) {
+    running = 0;
+    us_timer_close(t);
+}
+
+void *run_server(void *arg) {
+    us_loop_run(((struct server_t *) arg)->loop);
+    return 0;
+}
+
+int compare_samples(const void *a, const void *b) {
+    long long x = *(long long *) a, y = *(long long *) b;
+    return (x > y) - (x < y);
+}
+
+void run_mode(const char *name, int shared, int num_loops, int slow_ms, int seconds) {
+    struct server_t servers[MAX_LOOPS];
+    struct us_socket_context_options_t options = {};
+    struct us_listen_socket_t *first = 0;
+
+    for (int i = 0; i < num_loops; i++) {
+        servers[i].loop = us_create_loop(0, on_server_wakeup, on_pre, on_post, sizeof(struct server_t *));
+        *(struct server_t **) us_loop_ext(servers[i].loop) = &servers[i];
+        servers[i].slow_ms = i == 0 ? slow_ms : 0;
+
+        struct us_socket_context_t *context = us_create_socket_context(0, servers[i].loop, 0, options);
+        us_socket_context_on_open(0, context, on_server_open);
+        us_socket_context_on_data(0, context, on_server_data);
+        us_socket_context_on_writable(0, context, on_writable);
+        us_socket_context_on_close(0, context, on_close);
+        us_socket_context_on_end(0, context, on_end);
+        us_socket_context_on_timeout(0, context, on_timeout);
+        servers[i].context = context;
+
+        struct us_listen_socket_t *ls;
+        if (shared && first) {
+            ls = us_socket_context_share_listen_socket(0, context, first, 0);
+        } else {
+            ls = us_socket_context_listen(0, context, "127.0.0.1", PORT, 0, 0);
+        }
+        if (!ls) {
+            printf("Failed to listen on port %d!\n", PORT);
+            exit(1);
+        }
+        first = first ? first : ls;
+    }
+
+    for (int i = 0; i < num_loops; i++) {
+        pthread_create(&servers[i].thread, 0, run_server, &servers[i]);
+    }
+
+    /* Clients run on this thread */
+    struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+    client_context = us_create_socket_context(0, loop, 0, options);
+    us_socket_context_on_open(0, client_context, on_client_open);
+    us_socket_context_on_data(0, client_context, on_client_data);
+    us_socket_context_on_writable(0, client_context, on_writable);
+    us_socket_context_on_close(0, client_context, on_close);
+    us_socket_context_on_end(0, client_context, on_end);
+    us_socket_context_on_timeout(0, client_context, on_timeout);
+    us_socket_context_on_connect_error(0, client_context, on_client_connect_error);
+
+    num_samples = 0;
+    running = 1;
+    struct us_timer_t *timer = us_create_timer(loop, 0, 0);
+    us_timer_set(timer, on_client_done, seconds * 1000, 0);
+    for (int i = 0; i < CONCURRENCY; i++) {
+        client_connect();
+    }
+    us_loop_run(loop);
+
+    us_socket_context_free(0, client_context);
+    us_loop_free(loop);
+
+    for (int i = 0; i < num_loops; i++) {
+        us_wakeup_loop(servers[i].loop);
+        pthread_join(servers[i].thread, 0);
+        us_socket_context_free(0, servers[i].context);
+        us_loop_free(servers[i].loop);
+    }
+
+    qsort(samples, num_samples, sizeof(long long), compare_samples);
+    if (!num_samples) {
+        printf("%-10s no samples\n", name);
+        return;
+    }
+    printf("%-10s %8d connections  p50 %8.3f ms  p99 %8.3f ms  p99.9 %8.3f ms  max %8.3f ms\n", name, num_samples,
+        samples[num_samples / 2] / 1e6, samples[(long long) num_samples * 99 / 100] / 1e6,
+        samples[(long long) num_samples * 999 / 1000] / 1e6, samples[num_samples - 1] / 1e6);
+}
+
+int main(int argc, char **argv) {
+    int num_loops = argc > 1 ? atoi(argv[1]) : 4;
+    int slow_ms = argc > 2 ? atoi(argv[2]) : 20;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    if (num_loops < 1 || num_loops > MAX_LOOPS || slow_ms < 0 || seconds < 1) {
+        printf("Usage: shared_listen_benchmark [1 to %d loops] [slow ms] [seconds]\n", MAX_LOOPS);
+        return 0;
+    }
+
+    samples = malloc(sizeof(long long) * MAX_SAMPLES);
+    printf("%d loops, loop 0 takes %d ms per request, %d clients\n", num_loops, slow_ms, CONCURRENCY);
+    run_mode("reuseport", 0, num_loops, slow_ms, seconds);
+    run_mode("shared", 1, num_loops, slow_ms, seconds);
+    free(samples);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("Not available with io_uring backend or on Windows\n");
+}
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+/* One loop accepts, worker loops on other threads adopt. Each worker has a single producer single consumer
+ * ring the acceptor pushes descriptors into, and is woken once per batch of accepts rather than per
+ * connection. While a wakeup is still pending no other is sent, the worker picks up everything queued.
+ * Workers of a loop share one async, which keeps the loop alive until the acceptor closes */
+
+#ifndef LIBUS_ACCEPTOR_QUEUE_LENGTH
+#define LIBUS_ACCEPTOR_QUEUE_LENGTH 1024
+#endif
+
+struct us_internal_accepted_t {
+    LIBUS_SOCKET_DESCRIPTOR fd;
+    int ip_length;
+    char ip[16];
+};
+
+struct us_internal_acceptor_worker_t {
+    /* Other workers of the same loop, only touched on that loop's thread */
+    struct us_internal_acceptor_worker_t *next;
+    int linked;
+    int ssl;
+    struct us_socket_context_t *context;
+    int socket_ext_size;
+    /* The async of the worker's loop, not touched by the acceptor after closing */
+    struct us_internal_async *async;
+    /* Only touched by the acceptor */
+    int needs_wakeup;
+
+    /* Written by the acceptor, on its own cache line */
+    alignas(64) atomic_uint tail;
+    atomic_llong wakeup_sent_us;
+    atomic_int wakeup_pending;
+    atomic_int closing;
+
+    /* Written by the worker */
+    alignas(64) atomic_uint head;
+    atomic_int connections;
+    atomic_uint latency_us;
+
+    struct us_internal_accepted_t queue[LIBUS_ACCEPTOR_QUEUE_LENGTH];
+};
+
+struct us_acceptor_t {
+    struct us_socket_context_t *context;
+    int policy;
+    int (*custom_policy)(struct us_acceptor_worker_stats_t *workers, int num_workers, void *user_data);
+    void *user_data;
+    unsigned int next_worker;
+    int closed;
+    int num_workers;
+    struct us_internal_acceptor_worker_t **workers;
+    struct us_acceptor_worker_stats_t *stats;
+};
+
+static long long us_internal_acceptor_now_us() {
+    return us_internal_now_ns() / 1000;
+}
+
+static int us_internal_acceptor_queued(struct us_internal_acceptor_worker_t *w) {
+    return (int) (atomic_load_explicit(&w->tail, memory_order_relaxed) - atomic_load_explicit(&w->head, memory_order_acquire));
+}
+
+/* A wakeup not picked up yet counts for as long as it has been waiting */
+static unsigned int us_internal_acceptor_latency(struct us_internal_acceptor_worker_t *w, long long now) {
+    unsigned int latency = atomic_load_explicit(&w->latency_us, memory_order_relaxed);
+    if (atomic_load(&w->wakeup_pending)) {
+        long long waiting = now - atomic_load(&w->wakeup_sent_us);
+        if (waiting > latency) {
+            latency = (unsigned int) waiting;
+        }
+    }
+    return latency;
+}
+
+/* Returns the index of the worker to hand the next connection to, or -1 if none can take it */
+static int us_internal_acceptor_pick(struct us_acceptor_t *acceptor) {
+    if (acceptor->custom_policy) {
+        long long now = us_internal_acceptor_now_us();
+        for (int i = 0; i < acceptor->num_workers; i++) {
+            struct us_internal_acceptor_worker_t *w = acceptor->workers[i];
+            acceptor->stats[i].connections = atomic_load_explicit(&w->connections, memory_order_relaxed);
+            acceptor->stats[i].queued = us_internal_acceptor_queued(w);
+            acceptor->stats[i].latency_us = us_internal_acceptor_latency(w, now);
+        }
+        int i = acceptor->custom_policy(acceptor->stats, acceptor->num_workers, acceptor->user_data);
+        return (i >= 0 && i < acceptor->num_workers) ? i : -1;
+    }
+
+    int best = -1;
+    long long best_load = 0, now = 0;
+    if (acceptor->policy == LIBUS_ACCEPTOR_LEAST_LATENCY) {
+        now = us_internal_acceptor_now_us();
+    }
+
+    /* Starting after the last pick spreads ties */
+    for (int n = 0; n < acceptor->num_workers; n++) {
+        int i = (acceptor->next_worker + n) % acceptor->num_workers;
+        struct us_internal_acceptor_worker_t *w = acceptor->workers[i];
+        int queued = us_internal_acceptor_queued(w);
+        if (queued == LIBUS_ACCEPTOR_QUEUE_LENGTH) {
+            continue;
+        }
+
+        if (acceptor->policy == LIBUS_ACCEPTOR_ROUND_ROBIN) {
+            best = i;
+            break;
+        }
+
+        long long load = atomic_load_explicit(&w->connections, memory_order_relaxed) + queued;
+        if (acceptor->policy == LIBUS_ACCEPTOR_LEAST_LATENCY) {
+            /* Connections only break ties of latency */
+            load += (long long) us_internal_acceptor_latency(w, now) << 32;
+        }
+        if (best == -1 || load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+
+    if (best != -1) {
+        acceptor->next_worker = best + 1;
+    }
+    return best;
+}
+
+/* Accepts everything pending on a listen socket of the acceptor */
+void us_internal_acceptor_accept(struct us_acceptor_t *acceptor, LIBUS_SOCKET_DESCRIPTOR listen_fd) {
+    struct bsd_addr_t addr;
+    LIBUS_SOCKET_DESCRIPTOR fd;
+
+    while ((fd = bsd_accept_socket(listen_fd, &addr)) != LIBUS_SOCKET_ERROR) {
+        US_METRIC_ADD(acceptor->context->loop, accepts, 1);
+        US_PROBE2(accept, listen_fd, fd);
+        int i = us_internal_acceptor_pick(acceptor);
+        if (i == -1) {
+            /* Every worker is backed up, shed the connection rather than queue unboundedly */
+            bsd_close_socket(fd);
+            continue;
+        }
+
+        struct us_internal_acceptor_worker_t *w = acceptor->workers[i];
+        unsigned int tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+        if (tail - atomic_load_explicit(&w->head, memory_order_acquire) == LIBUS_ACCEPTOR_QUEUE_LENGTH) {
+            bsd_close_socket(fd);
+            continue;
+        }
+
+        struct us_internal_accepted_t *accepted = &w->queue[tail % LIBUS_ACCEPTOR_QUEUE_LENGTH];
+        accepted->fd = fd;
+        accepted->ip_length = bsd_addr_get_ip_length(&addr);
+        memcpy(accepted->ip, bsd_addr_get_ip(&addr), accepted->ip_length);
+        atomic_store_explicit(&w->tail, tail + 1, memory_order_release);
+        w->needs_wakeup = 1;
+    }
+
+    /* Only the acceptor raises wakeup_pending and only the worker clears it. The fences order each side's store
+     * before its load of what the other stores: a worker clearing it then sees the tail pushed, or we see it
+     * cleared and wake the worker again */
+    atomic_thread_fence(memory_order_seq_cst);
+    for (int i = 0; i < acceptor->num_workers; i++) {
+        struct us_internal_acceptor_worker_t *w = acceptor->workers[i];
+        if (w->needs_wakeup) {
+            w->needs_wakeup = 0;
+            if (!atomic_load(&w->wakeup_pending)) {
+                atomic_store(&w->wakeup_sent_us, us_internal_acceptor_now_us());
+                atomic_store(&w->wakeup_pending, 1);
+                us_internal_async_wakeup(w->async);
+            }
+        }
+    }
+}
+
+static void us_internal_acceptor_worker_drain(struct us_internal_acceptor_worker_t *w) {
+    if (atomic_load(&w->wakeup_pending)) {
+        long long latency = us_internal_acceptor_now_us() - atomic_load(&w->wakeup_sent_us);
+        long long smoothed = atomic_load_explicit(&w->latency_us, memory_order_relaxed);
+        /* Smoothed by 1/8 like TCP's round trip time */
+        atomic_store_explicit(&w->latency_us, (unsigned int) (smoothed + (latency - smoothed) / 8), memory_order_relaxed);
+
+        /* Cleared before reading the tail, anything pushed after that gets a wakeup of its own */
+        atomic_store(&w->wakeup_pending, 0);
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+
+    unsigned int head = atomic_load_explicit(&w->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+    for (; head != tail; head++) {
+        struct us_internal_accepted_t accepted = w->queue[head % LIBUS_ACCEPTOR_QUEUE_LENGTH];
+        atomic_store_explicit(&w->head, head + 1, memory_order_release);
+
+        /* Limits of the worker's context and loop apply here, where the socket is counted and released */
+        unsigned int source;
+        if (!us_internal_socket_context_admit(w->context, accepted.fd, accepted.ip, accepted.ip_length, &source)) {
+            continue;
+        }
+#ifndef LIBUS_NO_SSL
+        if (w->ssl) {
+            us_internal_ssl_adopt_accepted_socket((struct us_internal_ssl_socket_context_t *) w->context, accepted.fd,
+                w->socket_ext_size, accepted.ip, accepted.ip_length, source);
+            continue;
+        }
+#endif
+        us_internal_adopt_accepted_socket(w->context, accepted.fd, w->socket_ext_size, accepted.ip, accepted.ip_length, source);
+    }
+}
+
+/* Takes a worker off its loop, closing the async with the last one. Only on the loop's thread, or once it stopped */
+static void us_internal_acceptor_worker_unlink(struct us_internal_acceptor_worker_t *w) {
+    struct us_loop_t *loop = w->context->loop;
+    struct us_internal_acceptor_worker_t **link = &loop->data.acceptor_workers;
+    while (*link != w) {
+        link = &(*link)->next;
+    }
+    *link = w->next;
+    w->linked = 0;
+
+    if (!loop->data.acceptor_workers) {
+        us_internal_async_close(loop->data.acceptor_async);
+        loop->data.acceptor_async = 0;
+    }
+}
+
+/* Asyncs are called with the loop */
+static void us_internal_acceptor_async_cb(struct us_internal_async *a) {
+    struct us_loop_t *loop = (struct us_loop_t *) a;
+    struct us_internal_acceptor_worker_t *w = loop->data.acceptor_workers;
+    while (w) {
+        struct us_internal_acceptor_worker_t *next = w->next;
+        int closing = atomic_load(&w->closing);
+        us_internal_acceptor_worker_drain(w);
+        /* Nothing more comes once closing is seen, the loop may end when its sockets do */
+        if (closing) {
+            us_internal_acceptor_worker_unlink(w);
+        }
+        w = next;
+    }
+}
+
+/* Sockets of worker contexts come and go on the worker's thread */
+void us_internal_acceptor_worker_count(struct us_internal_acceptor_worker_t *w, int change) {
+    atomic_fetch_add_explicit(&w->connections, change, memory_order_relaxed);
+}
+
+struct us_acceptor_t *us_create_acceptor(struct us_loop_t *loop, int policy) {
+    struct us_socket_context_options_t options = {};
+    struct us_socket_context_t *context = us_create_socket_context(0, loop, 0, options);
+    if (!context) {
+        return 0;
+    }
+
+    struct us_acceptor_t *acceptor = calloc(1, sizeof(struct us_acceptor_t));
+    acceptor->context = context;
+    acceptor->policy = policy;
+    context->acceptor = acceptor;
+    return acceptor;
+}
+
+void us_acceptor_set_policy(struct us_acceptor_t *acceptor, int (*policy)(struct us_acceptor_worker_stats_t *workers, int num_workers, void *user_data), void *user_data) {
+    acceptor->custom_policy = policy;
+    acceptor->user_data = user_data;
+}
+
+int us_acceptor_add_worker(struct us_acceptor_t *acceptor, int ssl, struct us_socket_context_t *context, int socket_ext_size) {
+    if (context->acceptor_worker) {
+        return 0;
+    }
+
+    struct us_internal_acceptor_worker_t **workers = realloc(acceptor->workers, sizeof(*workers) * (acceptor->num_workers + 1));
+    struct us_acceptor_worker_stats_t *stats = realloc(acceptor->stats, sizeof(*stats) * (acceptor->num_workers + 1));
+    if (workers) {
+        acceptor->workers = workers;
+    }
+    if (stats) {
+        acceptor->stats = stats;
+    }
+    if (!workers || !stats) {
+        return 0;
+    }
+
+    struct us_internal_acceptor_worker_t *w = calloc(1, sizeof(struct us_internal_acceptor_worker_t));
+    if (!w) {
+        return 0;
+    }
+
+    struct us_loop_t *loop = us_socket_context_loop(ssl, context);
+    if (!loop->data.acceptor_async) {
+        loop->data.acceptor_async = us_internal_create_async(loop, 0, 0);
+        us_internal_async_set(loop->data.acceptor_async, us_internal_acceptor_async_cb);
+    }
+
+    w->async = loop->data.acceptor_async;
+    w->ssl = ssl;
+    w->context = context;
+    w->socket_ext_size = socket_ext_size;
+    w->next = loop->data.acceptor_workers;
+    w->linked = 1;
+    loop->data.acceptor_workers = w;
+
+    /* Sockets the context already has count too */
+    for (struct us_socket_t *s = context->head_sockets; s; s = s->next) {
+        w->connections++;
+    }
+    context->acceptor_worker = w;
+
+    acceptor->workers[acceptor->num_workers++] = w;
+    return 1;
+}
+
+struct us_listen_socket_t *us_acceptor_listen(struct us_acceptor_t *acceptor, const char *host, int port, int options) {
+    return us_socket_context_listen(0, acceptor->context, host, port, options, 0);
+}
+
+void us_acceptor_close(struct us_acceptor_t *acceptor) {
+    if (acceptor->closed) {
+        return;
+    }
+    us_socket_context_close(0, acceptor->context);
+    acceptor->closed = 1;
+
+    /* Workers let go of their loops once they picked up what is left */
+    for (int i = 0; i < acceptor->num_workers; i++) {
+        atomic_store(&acceptor->workers[i]->closing, 1);
+        us_internal_async_wakeup(acceptor->workers[i]->async);
+    }
+}
+
+void us_acceptor_free(struct us_acceptor_t *acceptor) {
+    us_socket_context_close(0, acceptor->context);
+    us_socket_context_free(0, acceptor->context);
+
+    for (int i = 0; i < acceptor->num_workers; i++) {
+        struct us_internal_acceptor_worker_t *w = acceptor->workers[i];
+
+        /* Handed over but never adopted */
+        unsigned int tail = atomic_load(&w->tail);
+        for (unsigned int head = atomic_load(&w->head); head != tail; head++) {
+            bsd_close_socket(w->queue[head % LIBUS_ACCEPTOR_QUEUE_LENGTH].fd);
+        }
+
+        if (w->linked) {
+            us_internal_acceptor_worker_unlink(w);
+        }
+        w->context->acceptor_worker = 0;
+        free(w);
+    }
+
+    free(acceptor->workers);
+    free(acceptor->stats);
+    free(acceptor);
+}
+
+#endif
@@ -296,6 +296,31 @@ void bsd_socket_nodelay(LIBUS_SOCKET_DESCRIPTOR fd, int enabled) {
     setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (void *) &enabled, sizeof(enabled));
 }
 
+/* Closing sends a reset instead of a FIN, dropping whatever was not sent and leaving no TIME_WAIT behind */
+void bsd_socket_reset_on_close(LIBUS_SOCKET_DESCRIPTOR fd) {
+    struct linger linger = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, (void *) &linger, sizeof(linger));
+}
+
+int bsd_socket_tcp_info(LIBUS_SOCKET_DESCRIPTOR fd, struct us_tcp_info_t *info) {
+#if defined(__linux__) && defined(TCP_INFO)
+    struct tcp_info tcp_info;
+    socklen_t length = sizeof(tcp_info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &tcp_info, &length) || length < sizeof(tcp_info)) {
+        return 0;
+    }
+    info->rtt_us = tcp_info.tcpi_rtt;
+    info->rtt_var_us = tcp_info.tcpi_rttvar;
+    info->cwnd = tcp_info.tcpi_snd_cwnd;
+    info->mss = tcp_info.tcpi_snd_mss;
+    info->total_retransmits = tcp_info.tcpi_total_retrans;
+    info->unacked_bytes = tcp_info.tcpi_unacked * tcp_info.tcpi_snd_mss;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
 void bsd_socket_flush(LIBUS_SOCKET_DESCRIPTOR fd) {
     // Linux TCP_CORK has the same underlying corking mechanism as with MSG_MORE
 #ifdef TCP_CORK
@@ -427,6 +452,66 @@ int bsd_write2(LIBUS_SOCKET_DESCRIPTOR fd, const char *header, int header_length
     
     return writev(fd, chunks, 2);
 }
+
+int bsd_send_fds(LIBUS_SOCKET_DESCRIPTOR fd, const char *buf, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds) {
+    struct iovec chunk = {(char *) buf, length};
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int) * LIBUS_MAX_PASSED_FDS)];
+    } control;
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &chunk;
+    msg.msg_iovlen = 1;
+    if (num_fds) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+    }
+
+#ifdef MSG_NOSIGNAL
+    return sendmsg(fd, &msg, MSG_NOSIGNAL);
+#else
+    return sendmsg(fd, &msg, 0);
+#endif
+}
+
+int bsd_recv_fds(LIBUS_SOCKET_DESCRIPTOR fd, void *buf, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int *num_fds) {
+    struct iovec chunk = {buf, length};
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int) * LIBUS_MAX_PASSED_FDS)];
+    } control;
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &chunk;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+#ifdef MSG_CMSG_CLOEXEC
+    int received = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+#else
+    int received = recvmsg(fd, &msg, 0);
+#endif
+
+    *num_fds = 0;
+    if (received < 0) {
+        return received;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int count = (int) ((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds + *num_fds, CMSG_DATA(cmsg), sizeof(int) * count);
+            *num_fds += count;
+        }
+    }
+    return received;
+}
 #else
 int bsd_write2(LIBUS_SOCKET_DESCRIPTOR fd, const char *header, int header_length, const char *payload, int payload_length) {
     int written = bsd_send(fd, header, header_length, 0);
@@ -438,6 +523,15 @@ int bsd_write2(LIBUS_SOCKET_DESCRIPTOR fd, const char *header, int header_length
     }
     return written;
 }
+
+int bsd_send_fds(LIBUS_SOCKET_DESCRIPTOR fd, const char *buf, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds) {
+    return num_fds ? -1 : bsd_send(fd, buf, length, 0);
+}
+
+int bsd_recv_fds(LIBUS_SOCKET_DESCRIPTOR fd, void *buf, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int *num_fds) {
+    *num_fds = 0;
+    return bsd_recv(fd, buf, length, 0);
+}
 #endif
 
 int bsd_send(LIBUS_SOCKET_DESCRIPTOR fd, const char *buf, int length, int msg_more) {
@@ -470,6 +564,31 @@ int bsd_would_block() {
 #endif
 }
 
+int bsd_create_pipe(LIBUS_SOCKET_DESCRIPTOR fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_NONBLOCK | O_CLOEXEC);
+#else
+    return LIBUS_SOCKET_ERROR;
+#endif
+}
+
+int bsd_splice(LIBUS_SOCKET_DESCRIPTOR fd_in, LIBUS_SOCKET_DESCRIPTOR fd_out, int length) {
+#ifdef __linux__
+    /* We never block here, the pipe and both sockets are non-blocking */
+    return (int) splice(fd_in, NULL, fd_out, NULL, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+    return LIBUS_SOCKET_ERROR;
+#endif
+}
+
+int bsd_pipe_read(LIBUS_SOCKET_DESCRIPTOR fd, void *buf, int length) {
+#ifdef _WIN32
+    return LIBUS_SOCKET_ERROR;
+#else
+    return (int) read(fd, buf, length);
+#endif
+}
+
 // return LIBUS_SOCKET_ERROR or the fd that represents listen socket
 // listen both on ipv6 and ipv4
 LIBUS_SOCKET_DESCRIPTOR bsd_create_listen_socket(const char *host, int port, int options) {
@@ -536,6 +655,14 @@ LIBUS_SOCKET_DESCRIPTOR bsd_create_listen_socket(const char *host, int port, int
     setsockopt(listenFd, IPPROTO_IPV6, IPV6_V6ONLY, (void *) &disabled, sizeof(disabled));
 #endif
 
+#ifdef TCP_FASTOPEN
+    if (options & LIBUS_LISTEN_FAST_OPEN) {
+        /* Length of the queue of connections accepted with data but without a completed handshake */
+        int queue_length = 512;
+        setsockopt(listenFd, IPPROTO_TCP, TCP_FASTOPEN, (void *) &queue_length, sizeof(queue_length));
+    }
+#endif
+
     if (bind(listenFd, listenAddr->ai_addr, (socklen_t) listenAddr->ai_addrlen) || listen(listenFd, 512)) {
         bsd_close_socket(listenFd);
         freeaddrinfo(result);
@@ -590,6 +717,23 @@ LIBUS_SOCKET_DESCRIPTOR bsd_create_listen_socket_unix(const char *path, int opti
     return listenFd;
 }
 
+int bsd_is_listen_socket(LIBUS_SOCKET_DESCRIPTOR fd) {
+    int listening = 0;
+    socklen_t length = sizeof(listening);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, (void *) &listening, &length)) {
+        return 0;
+    }
+    return listening;
+}
+
+LIBUS_SOCKET_DESCRIPTOR bsd_dup_socket(LIBUS_SOCKET_DESCRIPTOR fd) {
+#ifdef _WIN32
+    return LIBUS_SOCKET_ERROR;
+#else
+    return fcntl(fd, F_DUPFD_CLOEXEC, 0);
+#endif
+}
+
 LIBUS_SOCKET_DESCRIPTOR bsd_create_udp_socket(const char *host, int port) {
     struct addrinfo hints, *result;
     memset(&hints, 0, sizeof(struct addrinfo));
@@ -716,39 +860,154 @@ int bsd_udp_packet_buffer_ecn(void *msgvec, int index) {
     return 0; // no ecn defaults to 0
 }
 
-LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket(const char *host, int port, const char *source_host, int options) {
+int bsd_is_numeric_host(const char *host) {
+    /* Null means loopback, which needs no lookup either */
+    if (!host) {
+        return 1;
+    }
+
     struct addrinfo hints, *result;
     memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_flags = AI_NUMERICHOST;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0) {
+        return 0;
+    }
+    freeaddrinfo(result);
+    return 1;
+}
+
+int bsd_resolve_connect_host(const char *host, int port, struct addrinfo **result) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(struct addrinfo));
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
 
     char port_string[16];
     snprintf(port_string, 16, "%d", port);
 
-    if (getaddrinfo(host, port_string, &hints, &result) != 0) {
+    return getaddrinfo(host, port_string, &hints, result);
+}
+
+int bsd_resolve_source_host(const char *source_host, struct addrinfo **result) {
+    return getaddrinfo(source_host, NULL, NULL, result);
+}
+
+void bsd_free_addrinfo(struct addrinfo *result) {
+    freeaddrinfo(result);
+}
+
+int bsd_resolve_error_is_permanent(int error) {
+#ifdef EAI_NODATA
+    if (error == EAI_NODATA) {
+        return 1;
+    }
+#endif
+    return error == EAI_NONAME;
+}
+
+/* A TCP Fast Open connect holds back its SYN until the first write, which it then carries */
+static void bsd_connect_options(LIBUS_SOCKET_DESCRIPTOR fd, int options) {
+#ifdef TCP_FASTOPEN_CONNECT
+    if (options & LIBUS_CONNECT_FAST_OPEN) {
+        int enabled = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, (void *) &enabled, sizeof(enabled));
+    }
+#endif
+}
+
+int bsd_connect_addresses(struct addrinfo *result, struct addrinfo *source_result, struct bsd_addr_t *addresses, int max_length,
+    struct bsd_addr_t *source) {
+    source->len = 0;
+    if (source_result) {
+        memcpy(&source->mem, source_result->ai_addr, source_result->ai_addrlen);
+        source->len = (socklen_t) source_result->ai_addrlen;
+    }
+
+    /* The first address picks the family tried first, then they take turns */
+    int first_family = source_result ? source_result->ai_family : result->ai_family;
+    struct addrinfo *next[2] = {result, result};
+    int length = 0;
+
+    for (int turn = 0; length < max_length && (next[0] || next[1]); turn = !turn) {
+        struct addrinfo *a = next[turn];
+        while (a && ((a->ai_family == first_family) == turn || (a->ai_family != AF_INET && a->ai_family != AF_INET6))) {
+            a = a->ai_next;
+        }
+        next[turn] = a ? a->ai_next : 0;
+
+        if (a && (!source_result || a->ai_family == source_result->ai_family)) {
+            memcpy(&addresses[length].mem, a->ai_addr, a->ai_addrlen);
+            addresses[length].len = (socklen_t) a->ai_addrlen;
+            length++;
+        }
+    }
+    return length;
+}
+
+/* Binding a source address with port 0 would take an ephemeral port no other destination could use, so
+ * that is left to connect where supported. Connects bound to one address then run out of ports per destination */
+static int bsd_bind_source(LIBUS_SOCKET_DESCRIPTOR fd, struct sockaddr *addr, socklen_t addr_length) {
+#ifdef IP_BIND_ADDRESS_NO_PORT
+    int enabled = 1;
+    setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &enabled, sizeof(enabled));
+#endif
+    return bind(fd, addr, addr_length);
+}
+
+LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket_addr(struct bsd_addr_t *addr, struct bsd_addr_t *source, int options) {
+    LIBUS_SOCKET_DESCRIPTOR fd = bsd_create_socket(addr->mem.ss_family, SOCK_STREAM, 0);
+    if (fd == LIBUS_SOCKET_ERROR) {
         return LIBUS_SOCKET_ERROR;
     }
 
+    if (source && source->len) {
+        if (bsd_bind_source(fd, (struct sockaddr *) &source->mem, source->len) == LIBUS_SOCKET_ERROR) {
+            bsd_close_socket(fd);
+            return LIBUS_SOCKET_ERROR;
+        }
+    }
+
+    bsd_connect_options(fd, options);
+    connect(fd, (struct sockaddr *) &addr->mem, addr->len);
+
+    return fd;
+}
+
+/* Source addresses that failed to resolve are ignored */
+LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket_resolved(struct addrinfo *result, struct addrinfo *source_result, int options) {
     LIBUS_SOCKET_DESCRIPTOR fd = bsd_create_socket(result->ai_family, result->ai_socktype, result->ai_protocol);
     if (fd == LIBUS_SOCKET_ERROR) {
-        freeaddrinfo(result);
         return LIBUS_SOCKET_ERROR;
     }
 
-    if (source_host) {
-        struct addrinfo *interface_result;
-        if (!getaddrinfo(source_host, NULL, NULL, &interface_result)) {
-            int ret = bind(fd, interface_result->ai_addr, (socklen_t) interface_result->ai_addrlen);
-            freeaddrinfo(interface_result);
-            if (ret == LIBUS_SOCKET_ERROR) {
-                bsd_close_socket(fd);
-                freeaddrinfo(result);
-                return LIBUS_SOCKET_ERROR;
-            }
+    if (source_result) {
+        if (bsd_bind_source(fd, source_result->ai_addr, (socklen_t) source_result->ai_addrlen) == LIBUS_SOCKET_ERROR) {
+            bsd_close_socket(fd);
+            return LIBUS_SOCKET_ERROR;
         }
     }
 
+    bsd_connect_options(fd, options);
     connect(fd, result->ai_addr, (socklen_t) result->ai_addrlen);
+
+    return fd;
+}
+
+LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket(const char *host, int port, const char *source_host, int options) {
+    struct addrinfo *result, *source_result = NULL;
+    if (bsd_resolve_connect_host(host, port, &result) != 0) {
+        return LIBUS_SOCKET_ERROR;
+    }
+
+    if (source_host && bsd_resolve_source_host(source_host, &source_result) != 0) {
+        source_result = NULL;
+    }
+
+    LIBUS_SOCKET_DESCRIPTOR fd = bsd_create_connect_socket_resolved(result, source_result, options);
+
+    if (source_result) {
+        freeaddrinfo(source_result);
+    }
     freeaddrinfo(result);
 
     return fd;
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+
+/* Load generators open thousands of connections to the same address. The address is resolved once and the
+ * sockets are created in batches off a timer, going round the source addresses as each has its own ephemeral ports */
+
+#define BULK_CONNECT_DEFAULT_INTERVAL_MS 1
+
+/* Where a connection goes and what it is bound to */
+struct us_internal_bulk_target_t {
+    struct bsd_addr_t addr;
+    struct bsd_addr_t source;
+};
+
+struct us_internal_bulk_connect_t {
+    struct us_internal_bulk_connect_t *next;
+    int ssl;
+    struct us_socket_context_t *context;
+    struct us_timer_t *timer;
+    int remaining;
+    int started;
+    void (*on_done)(struct us_socket_context_t *context, int started);
+    int per_tick;
+    int options;
+    int socket_ext_size;
+    int next_target;
+    int num_targets;
+    struct us_internal_bulk_target_t targets[];
+};
+
+/* Frees the bulk and tells the app how many connects it started */
+static void us_internal_bulk_connect_finish(struct us_internal_bulk_connect_t *bulk) {
+    struct us_internal_bulk_connect_t **link = &bulk->context->bulk_connects;
+    while (*link != bulk) {
+        link = &(*link)->next;
+    }
+    *link = bulk->next;
+
+    if (bulk->timer) {
+        us_timer_close(bulk->timer);
+    }
+
+    struct us_socket_context_t *context = bulk->context;
+    int started = bulk->started;
+    void (*on_done)(struct us_socket_context_t *context, int started) = bulk->on_done;
+    free(bulk);
+
+    if (on_done) {
+        on_done(context, started);
+    }
+}
+
+/* Returns 0 once done, the bulk is freed then */
+static int us_internal_bulk_connect_batch(struct us_internal_bulk_connect_t *bulk) {
+    int batch = bulk->per_tick && bulk->per_tick < bulk->remaining ? bulk->per_tick : bulk->remaining;
+
+    for (int i = 0; i < batch; i++) {
+        struct us_internal_bulk_target_t *target = &bulk->targets[bulk->next_target];
+        bulk->next_target = (bulk->next_target + 1) % bulk->num_targets;
+
+        /* Out of descriptors or ports most likely, trying the rest would fail the same until sockets of the
+         * context close. Without any open there is nothing to wait for */
+        if (!us_internal_socket_context_connect_addr(bulk->ssl, bulk->context, &target->addr, &target->source, bulk->options, bulk->socket_ext_size)) {
+            if (!bulk->context->num_sockets) {
+                bulk->remaining = 0;
+            }
+            break;
+        }
+        bulk->remaining--;
+        bulk->started++;
+    }
+
+    if (!bulk->remaining) {
+        us_internal_bulk_connect_finish(bulk);
+        return 0;
+    }
+    return 1;
+}
+
+static void us_internal_bulk_connect_tick(struct us_timer_t *t) {
+    us_internal_bulk_connect_batch(*(struct us_internal_bulk_connect_t **) us_timer_ext(t));
+}
+
+int us_socket_context_connect_many(int ssl, struct us_socket_context_t *context, const char *host, int port, int count,
+    int socket_ext_size, struct us_connect_many_options_t options) {
+    if (count <= 0) {
+        return 0;
+    }
+
+    struct addrinfo *result;
+    if (bsd_resolve_connect_host(host, port, &result)) {
+        return 0;
+    }
+
+    int num_sources = options.source_host_count > 0 ? options.source_host_count : 1;
+    struct us_internal_bulk_connect_t *bulk = malloc(sizeof(struct us_internal_bulk_connect_t) + num_sources * sizeof(struct us_internal_bulk_target_t));
+    if (!bulk) {
+        bsd_free_addrinfo(result);
+        return 0;
+    }
+
+    /* Sources that do not resolve or have no address of their family to connect to are skipped */
+    bulk->num_targets = 0;
+    for (int i = 0; i < num_sources; i++) {
+        struct addrinfo *source_result = 0;
+        if (options.source_host_count > 0 && bsd_resolve_source_host(options.source_hosts[i], &source_result)) {
+            continue;
+        }
+
+        struct us_internal_bulk_target_t *target = &bulk->targets[bulk->num_targets];
+        if (bsd_connect_addresses(result, source_result, &target->addr, 1, &target->source)) {
+            bulk->num_targets++;
+        }
+        if (source_result) {
+            bsd_free_addrinfo(source_result);
+        }
+    }
+    bsd_free_addrinfo(result);
+
+    if (!bulk->num_targets) {
+        free(bulk);
+        return 0;
+    }
+
+    bulk->ssl = ssl;
+    bulk->context = context;
+    bulk->timer = 0;
+    bulk->remaining = count;
+    bulk->started = 0;
+    bulk->on_done = options.on_done;
+    bulk->per_tick = options.per_tick;
+    bulk->options = options.options;
+    bulk->socket_ext_size = socket_ext_size;
+    bulk->next_target = 0;
+    bulk->next = context->bulk_connects;
+    context->bulk_connects = bulk;
+
+    /* The first batch goes right away */
+    if (!us_internal_bulk_connect_batch(bulk)) {
+        return 1;
+    }
+
+    bulk->timer = us_create_timer(context->loop, 0, sizeof(struct us_internal_bulk_connect_t *));
+    if (!bulk->timer) {
+        us_internal_bulk_connect_finish(bulk);
+        return 1;
+    }
+    *(struct us_internal_bulk_connect_t **) us_timer_ext(bulk->timer) = bulk;
+
+    unsigned int interval_ms = options.interval_ms ? options.interval_ms : BULK_CONNECT_DEFAULT_INTERVAL_MS;
+    us_timer_set(bulk->timer, us_internal_bulk_connect_tick, interval_ms, interval_ms);
+    return 1;
+}
+
+/* Connections not yet started are not started once the context closes */
+void us_internal_bulk_connect_cancel(struct us_socket_context_t *context) {
+    while (context->bulk_connects) {
+        us_internal_bulk_connect_finish(context->bulk_connects);
+    }
+}
+
+#endif
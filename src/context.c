@@ -50,6 +50,55 @@ void us_listen_socket_close(int ssl, struct us_listen_socket_t *ls) {
     /* We cannot immediately free a listen socket as we can be inside an accept loop */
 }
 
+/* Listen sockets poll for connections unless paused or their context is shedding load */
+static void us_internal_listen_socket_update(struct us_listen_socket_t *ls) {
+    int accepting = !(ls->s.flags & SOCKET_FLAG_PAUSED) && !ls->s.context->shedding;
+    us_poll_change((struct us_poll_t *) &ls->s, ls->s.context->loop, accepting ? LIBUS_SOCKET_READABLE : 0);
+}
+
+void us_listen_socket_pause(int ssl, struct us_listen_socket_t *ls) {
+    if (!us_socket_is_closed(0, &ls->s)) {
+        ls->s.flags |= SOCKET_FLAG_PAUSED;
+        us_internal_listen_socket_update(ls);
+    }
+}
+
+void us_listen_socket_resume(int ssl, struct us_listen_socket_t *ls) {
+    if (!us_socket_is_closed(0, &ls->s)) {
+        ls->s.flags &= ~SOCKET_FLAG_PAUSED;
+        us_internal_listen_socket_update(ls);
+    }
+}
+
+int us_listen_socket_is_accepting(int ssl, struct us_listen_socket_t *ls) {
+    return !us_socket_is_closed(0, &ls->s) && us_poll_events((struct us_poll_t *) &ls->s) != 0;
+}
+
+void us_internal_socket_context_shed(struct us_socket_context_t *context, int reason, int on) {
+    int was_shedding = context->shedding != 0;
+    if (on) {
+        context->shedding |= reason;
+    } else {
+        context->shedding &= ~reason;
+    }
+
+    if (was_shedding != (context->shedding != 0)) {
+        for (struct us_listen_socket_t *ls = context->head_listen_sockets; ls; ls = (struct us_listen_socket_t *) ls->s.next) {
+            us_internal_listen_socket_update(ls);
+        }
+    }
+}
+
+void us_socket_context_shed_load(int ssl, struct us_socket_context_t *context, unsigned int max_sockets, int level) {
+    struct us_loop_lag_t lag;
+    us_loop_lag(context->loop, &lag);
+
+    context->shed_sockets = max_sockets;
+    context->shed_level = level;
+    us_internal_socket_context_shed(context, SHED_SOCKETS, max_sockets && context->num_sockets >= max_sockets);
+    us_internal_socket_context_shed(context, SHED_OVERLOAD, level > 0 && lag.level >= level);
+}
+
 void us_socket_context_close(int ssl, struct us_socket_context_t *context) {
     /* Begin by closing all listen sockets */
     struct us_listen_socket_t *ls = context->head_listen_sockets;
@@ -66,6 +115,75 @@ void us_socket_context_close(int ssl, struct us_socket_context_t *context) {
         us_socket_close(ssl, s, 0, 0);
         s = nextS;
     }
+
+    /* And those waiting in the low-priority queue of the loop, which are not in the list of the context */
+    s = context->loop->data.low_prio_head;
+    while (s) {
+        struct us_socket_t *nextS = s->next;
+        if (s->context == context) {
+            us_socket_close(ssl, s, 0, 0);
+        }
+        s = nextS;
+    }
+
+    if (context->pool) {
+        us_internal_pool_close(context);
+    }
+    if (context->bulk_connects) {
+        us_internal_bulk_connect_cancel(context);
+    }
+}
+
+/* A draining context is checked this often, so that the loop can end soon after its last socket closed */
+#define DRAIN_CHECK_MS 100
+
+struct us_internal_drain_t {
+    int ssl;
+    struct us_socket_context_t *context;
+    unsigned int checks_left;
+};
+
+static void us_internal_drain_check(struct us_timer_t *t) {
+    struct us_internal_drain_t *drain = (struct us_internal_drain_t *) us_timer_ext(t);
+    struct us_socket_context_t *context = drain->context;
+    int ssl = drain->ssl;
+
+    /* Sockets in the low-priority queue are counted but not in the list of the context */
+    if (context->num_sockets && drain->checks_left) {
+        drain->checks_left--;
+        return;
+    }
+
+    context->drain_timer = 0;
+    us_timer_close(t);
+
+    /* Past the deadline */
+    if (context->num_sockets) {
+        us_socket_context_close(ssl, context);
+    }
+}
+
+void us_socket_context_drain(int ssl, struct us_socket_context_t *context, unsigned int seconds) {
+    /* Stop accepting. Listen sockets handed to another process keep their queue of connections there */
+    struct us_listen_socket_t *ls = context->head_listen_sockets;
+    while (ls) {
+        struct us_listen_socket_t *nextLS = (struct us_listen_socket_t *) ls->s.next;
+        us_listen_socket_close(ssl, ls);
+        ls = nextLS;
+    }
+
+    if (!context->drain_timer) {
+        context->drain_timer = us_create_timer(context->loop, 0, sizeof(struct us_internal_drain_t));
+        if (!context->drain_timer) {
+            return;
+        }
+        us_timer_set(context->drain_timer, us_internal_drain_check, DRAIN_CHECK_MS, DRAIN_CHECK_MS);
+    }
+
+    struct us_internal_drain_t *drain = (struct us_internal_drain_t *) us_timer_ext(context->drain_timer);
+    drain->ssl = ssl;
+    drain->context = context;
+    drain->checks_left = seconds * (1000 / DRAIN_CHECK_MS);
 }
 
 void us_internal_socket_context_unlink_listen_socket(struct us_socket_context_t *context, struct us_listen_socket_t *ls) {
@@ -106,6 +224,15 @@ void us_internal_socket_context_unlink_socket(struct us_socket_context_t *contex
             s->next->prev = s->prev;
         }
     }
+
+    if (context->acceptor_worker) {
+        us_internal_acceptor_worker_count(context->acceptor_worker, -1);
+    }
+
+    /* Sockets queued for low priority are still counted */
+    if (s->low_prio_state != 1) {
+        us_internal_socket_context_count(context, s, -1);
+    }
 }
 
 /* We always add in the top, so we don't modify any s.next */
@@ -128,6 +255,68 @@ void us_internal_socket_context_link_socket(struct us_socket_context_t *context,
         context->head_sockets->prev = s;
     }
     context->head_sockets = s;
+
+    if (context->acceptor_worker) {
+        us_internal_acceptor_worker_count(context->acceptor_worker, 1);
+    }
+
+    if (s->low_prio_state != 1) {
+        us_internal_socket_context_count(context, s, 1);
+    }
+}
+
+void us_internal_socket_context_count(struct us_socket_context_t *context, struct us_socket_t *s, int change) {
+    context->num_sockets += change;
+    if (us_internal_poll_type(&s->p) == POLL_TYPE_SEMI_SOCKET) {
+        context->num_connecting += change;
+    }
+
+    if (context->shed_sockets && (context->num_sockets >= context->shed_sockets) != ((context->shedding & SHED_SOCKETS) != 0)) {
+        us_internal_socket_context_shed(context, SHED_SOCKETS, context->num_sockets >= context->shed_sockets);
+    }
+}
+
+int us_internal_socket_context_reject(struct us_socket_context_t *context, int connecting) {
+    int reason;
+    if (context->limits.max_sockets && context->num_sockets >= context->limits.max_sockets) {
+        reason = LIBUS_REJECT_SOCKETS;
+    } else if (connecting && context->limits.max_connecting && context->num_connecting >= context->limits.max_connecting) {
+        reason = LIBUS_REJECT_CONNECTING;
+    } else if (!connecting && context->limits.max_handshaking && context->num_handshaking >= context->limits.max_handshaking) {
+        reason = LIBUS_REJECT_HANDSHAKING;
+    } else {
+        return 0;
+    }
+    US_COUNTER_ADD(context->rejected[reason], 1);
+    return 1;
+}
+
+int us_internal_socket_context_admit(struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR fd, char *ip, int ip_length, unsigned int *source) {
+    *source = 0;
+    if (us_internal_socket_context_reject(context, 0) || (context->loop->data.ip_limiter &&
+        !us_internal_ip_limiter_admit(context, ip, ip_length, source))) {
+        if (context->limits.reset) {
+            bsd_socket_reset_on_close(fd);
+        }
+        bsd_close_socket(fd);
+        return 0;
+    }
+    return 1;
+}
+
+void us_socket_context_set_limits(int ssl, struct us_socket_context_t *context, const struct us_socket_context_limits_t *limits) {
+    if (limits) {
+        context->limits = *limits;
+    } else {
+        memset(&context->limits, 0, sizeof(context->limits));
+    }
+}
+
+unsigned long long us_socket_context_rejected(int ssl, struct us_socket_context_t *context, int reason) {
+    if (reason < 0 || reason >= LIBUS_REJECT_TYPES) {
+        return 0;
+    }
+    return US_COUNTER_LOAD(context->rejected[reason]);
 }
 
 struct us_loop_t *us_socket_context_loop(int ssl, struct us_socket_context_t *context) {
@@ -219,6 +408,25 @@ struct us_socket_context_t *us_create_socket_context(int ssl, struct us_loop_t *
     context->iterator = 0;
     context->next = 0;
     context->is_low_prio = default_is_low_prio_handler;
+    context->framing = 0;
+    context->pool = 0;
+    context->bulk_connects = 0;
+    context->on_fds = 0;
+    context->drain_timer = 0;
+    context->acceptor = 0;
+    context->acceptor_worker = 0;
+    context->tcp_sampler = 0;
+    context->num_sockets = 0;
+    context->num_connecting = 0;
+    context->num_handshaking = 0;
+    memset(&context->limits, 0, sizeof(context->limits));
+    memset(context->rejected, 0, sizeof(context->rejected));
+    context->shed_sockets = 0;
+    context->shed_level = 0;
+    context->shedding = 0;
+#ifdef LIBUS_USE_CALLBACK_TIMING
+    context->callback_timing = 0;
+#endif
 
     /* Begin at 0 */
     context->timestamp = 0;
@@ -247,25 +455,27 @@ void us_socket_context_free(int ssl, struct us_socket_context_t *context) {
      * This is the opposite order compared to when creating the context - SSL code is cleaning up before non-SSL */
 
     us_internal_loop_unlink(context->loop, context);
-    free(context);
-}
-
-struct us_listen_socket_t *us_socket_context_listen(int ssl, struct us_socket_context_t *context, const char *host, int port, int options, int socket_ext_size) {
-#ifndef LIBUS_NO_SSL
-    if (ssl) {
-        return us_internal_ssl_socket_context_listen((struct us_internal_ssl_socket_context_t *) context, host, port, options, socket_ext_size);
-    }
+    free(context->framing);
+    free(context->tcp_sampler);
+#ifdef LIBUS_USE_CALLBACK_TIMING
+    free(context->callback_timing);
 #endif
-
-    LIBUS_SOCKET_DESCRIPTOR listen_socket_fd = bsd_create_listen_socket(host, port, options);
-
-    if (listen_socket_fd == LIBUS_SOCKET_ERROR) {
-        return 0;
+    if (context->pool) {
+        us_internal_pool_free(context);
+    }
+    if (context->bulk_connects) {
+        us_internal_bulk_connect_cancel(context);
+    }
+    if (context->drain_timer) {
+        us_timer_close(context->drain_timer);
     }
+    free(context);
+}
 
+/* Polls a listening descriptor as a listen socket of context */
+static struct us_listen_socket_t *us_internal_socket_context_listen_fd(struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR listen_socket_fd, int socket_ext_size) {
     struct us_poll_t *p = us_create_poll(context->loop, 0, sizeof(struct us_listen_socket_t));
     us_poll_init(p, listen_socket_fd, POLL_TYPE_SEMI_SOCKET);
-    us_poll_start(p, context->loop, LIBUS_SOCKET_READABLE);
 
     struct us_listen_socket_t *ls = (struct us_listen_socket_t *) p;
 
@@ -273,14 +483,38 @@ struct us_listen_socket_t *us_socket_context_listen(int ssl, struct us_socket_co
     ls->s.timeout = 255;
     ls->s.long_timeout = 255;
     ls->s.low_prio_state = 0;
+    ls->s.aux = 0;
+    ls->s.flags = 0;
+    ls->s.read_shift = 0;
     ls->s.next = 0;
+    us_poll_start(p, context->loop, LIBUS_SOCKET_READABLE);
     us_internal_socket_context_link_listen_socket(context, ls);
 
     ls->socket_ext_size = socket_ext_size;
 
+    if (context->shedding) {
+        us_internal_listen_socket_update(ls);
+    }
+
     return ls;
 }
 
+struct us_listen_socket_t *us_socket_context_listen(int ssl, struct us_socket_context_t *context, const char *host, int port, int options, int socket_ext_size) {
+#ifndef LIBUS_NO_SSL
+    if (ssl) {
+        return us_internal_ssl_socket_context_listen((struct us_internal_ssl_socket_context_t *) context, host, port, options, socket_ext_size);
+    }
+#endif
+
+    LIBUS_SOCKET_DESCRIPTOR listen_socket_fd = bsd_create_listen_socket(host, port, options);
+
+    if (listen_socket_fd == LIBUS_SOCKET_ERROR) {
+        return 0;
+    }
+
+    return us_internal_socket_context_listen_fd(context, listen_socket_fd, socket_ext_size);
+}
+
 struct us_listen_socket_t *us_socket_context_listen_unix(int ssl, struct us_socket_context_t *context, const char *path, int options, int socket_ext_size) {
 #ifndef LIBUS_NO_SSL
     if (ssl) {
@@ -294,40 +528,292 @@ struct us_listen_socket_t *us_socket_context_listen_unix(int ssl, struct us_sock
         return 0;
     }
 
-    struct us_poll_t *p = us_create_poll(context->loop, 0, sizeof(struct us_listen_socket_t));
-    us_poll_init(p, listen_socket_fd, POLL_TYPE_SEMI_SOCKET);
-    us_poll_start(p, context->loop, LIBUS_SOCKET_READABLE);
+    return us_internal_socket_context_listen_fd(context, listen_socket_fd, socket_ext_size);
+}
 
-    struct us_listen_socket_t *ls = (struct us_listen_socket_t *) p;
+struct us_listen_socket_t *us_socket_context_adopt_listen_socket(int ssl, struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR fd, int socket_ext_size) {
+#ifndef LIBUS_NO_SSL
+    if (ssl) {
+        return us_internal_ssl_socket_context_adopt_listen_socket((struct us_internal_ssl_socket_context_t *) context, fd, socket_ext_size);
+    }
+#endif
 
-    ls->s.context = context;
-    ls->s.timeout = 255;
-    ls->s.long_timeout = 255;
-    ls->s.low_prio_state = 0;
-    ls->s.next = 0;
-    us_internal_socket_context_link_listen_socket(context, ls);
+    if (!bsd_is_listen_socket(fd)) {
+        return 0;
+    }
 
-    ls->socket_ext_size = socket_ext_size;
+    return us_internal_socket_context_listen_fd(context, bsd_set_nonblocking(fd), socket_ext_size);
+}
 
-    return ls;
+struct us_listen_socket_t *us_socket_context_share_listen_socket(int ssl, struct us_socket_context_t *context, struct us_listen_socket_t *ls, int socket_ext_size) {
+    /* A descriptor of its own so that either side closes independently */
+    LIBUS_SOCKET_DESCRIPTOR fd = bsd_dup_socket(us_poll_fd((struct us_poll_t *) &ls->s));
+    if (fd == LIBUS_SOCKET_ERROR) {
+        return 0;
+    }
+
+    struct us_listen_socket_t *shared = us_socket_context_adopt_listen_socket(ssl, context, fd, socket_ext_size);
+    if (!shared) {
+        bsd_close_socket(fd);
+        return 0;
+    }
+
+    /* Registered again to be polled exclusively, which only the thread of its loop may do */
+    struct us_poll_t *p = (struct us_poll_t *) &shared->s;
+    int events = us_poll_events(p);
+    shared->s.flags |= SOCKET_FLAG_SHARED_LISTEN;
+    us_poll_stop(p, context->loop);
+    us_poll_start(p, context->loop, events);
+    return shared;
 }
 
-struct us_socket_t *us_socket_context_connect(int ssl, struct us_socket_context_t *context, const char *host, int port, const char *source_host, int options, int socket_ext_size) {
-#ifndef LIBUS_NO_SSL
-    if (ssl) {
-        return (struct us_socket_t *) us_internal_ssl_socket_context_connect((struct us_internal_ssl_socket_context_t *) context, host, port, source_host, options, socket_ext_size);
+LIBUS_SOCKET_DESCRIPTOR us_listen_socket_fd(struct us_listen_socket_t *ls) {
+    return us_poll_fd((struct us_poll_t *) &ls->s);
+}
+
+#ifdef LIBUS_USE_HAPPY_EYEBALLS
+
+/* Happy Eyeballs (RFC 8305): a host name resolving to several addresses is connected to by attempts that start
+ * one connection attempt delay apart, or as soon as the previous one fails. The socket the app holds always
+ * has an attempt of its own, later ones are semi-sockets of their own which the first to connect hands its
+ * descriptor to. */
+
+#define CONNECT_RACE_MAX_ADDRESSES 8
+
+/* Milliseconds between starting attempts, RFC 8305 recommends 250 */
+#ifndef LIBUS_CONNECT_ATTEMPT_DELAY
+#define LIBUS_CONNECT_ATTEMPT_DELAY 250
+#endif
+
+struct us_internal_connect_race_t {
+    struct us_socket_t *s;
+    struct us_timer_t *timer;
+    /* Attempts in flight besides the one of s, oldest first */
+    struct us_socket_t *attempts[CONNECT_RACE_MAX_ADDRESSES];
+    int num_attempts;
+    struct bsd_addr_t addresses[CONNECT_RACE_MAX_ADDRESSES];
+    int num_addresses;
+    int next_address;
+    struct bsd_addr_t source;
+    int options;
+};
+
+/* Returns the descriptor of the next address that could be tried, or LIBUS_SOCKET_ERROR once none are left */
+static LIBUS_SOCKET_DESCRIPTOR us_internal_connect_race_next_fd(struct us_internal_connect_race_t *race) {
+    while (race->next_address < race->num_addresses) {
+        LIBUS_SOCKET_DESCRIPTOR fd = bsd_create_connect_socket_addr(&race->addresses[race->next_address++], &race->source, race->options);
+        if (fd != LIBUS_SOCKET_ERROR) {
+            return fd;
+        }
+    }
+    return LIBUS_SOCKET_ERROR;
+}
+
+/* Retires an attempt, its descriptor is closed unless another socket took it over */
+static void us_internal_connect_race_drop_attempt(struct us_internal_connect_race_t *race, int index, int close_fd) {
+    struct us_socket_t *attempt = race->attempts[index];
+    memmove(race->attempts + index, race->attempts + index + 1, sizeof(struct us_socket_t *) * (--race->num_attempts - index));
+
+    us_poll_stop(&attempt->p, attempt->context->loop);
+    if (close_fd) {
+        bsd_close_socket(us_poll_fd(&attempt->p));
+    }
+
+    /* Freed after this iteration like any closed socket, events of it may still be dispatched in this one */
+    attempt->aux->connect_race = 0;
+    attempt->next = attempt->context->loop->data.closed_head;
+    attempt->context->loop->data.closed_head = attempt;
+    attempt->prev = (struct us_socket_t *) attempt->context;
+}
+
+/* Moves the connecting descriptor of s over to fd */
+static void us_internal_connect_race_replace_fd(struct us_socket_t *s, LIBUS_SOCKET_DESCRIPTOR fd) {
+    us_poll_stop(&s->p, s->context->loop);
+    bsd_close_socket(us_poll_fd(&s->p));
+    us_poll_init(&s->p, fd, POLL_TYPE_SEMI_SOCKET);
+    us_poll_start(&s->p, s->context->loop, LIBUS_SOCKET_WRITABLE);
+}
+
+static void us_internal_connect_race_timer_cb(struct us_timer_t *t);
+
+/* Starts the next attempt next to those in flight, returns 0 if no address was left to try */
+static int us_internal_connect_race_start_attempt(struct us_internal_connect_race_t *race) {
+    LIBUS_SOCKET_DESCRIPTOR fd = us_internal_connect_race_next_fd(race);
+    if (fd == LIBUS_SOCKET_ERROR) {
+        return 0;
+    }
+
+    struct us_socket_t *attempt = (struct us_socket_t *) us_create_poll(race->s->context->loop, 0, sizeof(struct us_socket_t));
+    attempt->context = race->s->context;
+    attempt->timeout = 255;
+    attempt->long_timeout = 255;
+    attempt->low_prio_state = 0;
+    attempt->flags = 0;
+    attempt->read_shift = 0;
+    attempt->prev = attempt->next = 0;
+    attempt->aux = calloc(1, sizeof(struct us_internal_socket_aux_t));
+    if (!attempt->aux) {
+        bsd_close_socket(fd);
+        us_poll_free(&attempt->p, attempt->context->loop);
+        return 0;
+    }
+    attempt->aux->connect_race = race;
+
+    us_poll_init(&attempt->p, fd, POLL_TYPE_SEMI_SOCKET);
+    us_poll_start(&attempt->p, attempt->context->loop, LIBUS_SOCKET_WRITABLE);
+    race->attempts[race->num_attempts++] = attempt;
+    return 1;
+}
+
+/* The next attempt starts a connection attempt delay after the last one unless that one fails first */
+static void us_internal_connect_race_schedule(struct us_internal_connect_race_t *race) {
+    if (race->next_address == race->num_addresses) {
+        if (race->timer) {
+            us_timer_close(race->timer);
+            race->timer = 0;
+        }
+        return;
+    }
+    us_timer_set(race->timer, us_internal_connect_race_timer_cb, LIBUS_CONNECT_ATTEMPT_DELAY, 0);
+}
+
+static void us_internal_connect_race_timer_cb(struct us_timer_t *t) {
+    struct us_internal_connect_race_t *race = *(struct us_internal_connect_race_t **) us_timer_ext(t);
+    us_internal_connect_race_start_attempt(race);
+    us_internal_connect_race_schedule(race);
+}
+
+/* Ends the race of s, closing whatever attempts are left */
+void us_internal_connect_race_cancel(struct us_socket_t *s) {
+    struct us_internal_connect_race_t *race = s->aux->connect_race;
+    while (race->num_attempts) {
+        us_internal_connect_race_drop_attempt(race, 0, 1);
+    }
+    if (race->timer) {
+        us_timer_close(race->timer);
+    }
+    free(race);
+    s->aux->connect_race = 0;
+}
+
+/* Called when a racing socket moved in memory */
+void us_internal_connect_race_adopt(struct us_socket_t *s) {
+    struct us_internal_connect_race_t *race = s->aux->connect_race;
+    race->s = s;
+    for (int i = 0; i < race->num_attempts; i++) {
+        race->attempts[i]->context = s->context;
+    }
+}
+
+/* Called with any attempt that connected or failed. Returns the socket of the app once the race is decided,
+ * with error set if every attempt failed, or null while it goes on */
+struct us_socket_t *us_internal_connect_race_settle(struct us_socket_t *attempt, int *error) {
+    struct us_internal_connect_race_t *race = attempt->aux->connect_race;
+    struct us_socket_t *s = race->s;
+
+    if (!*error) {
+        /* The winner might be one of the later attempts, which hands over its descriptor */
+        if (attempt != s) {
+            int index = 0;
+            while (race->attempts[index] != attempt) {
+                index++;
+            }
+            LIBUS_SOCKET_DESCRIPTOR fd = us_poll_fd(&attempt->p);
+            us_internal_connect_race_drop_attempt(race, index, 0);
+            us_internal_connect_race_replace_fd(s, fd);
+        }
+        us_internal_connect_race_cancel(s);
+        return s;
+    }
+
+    if (attempt != s) {
+        int index = 0;
+        while (race->attempts[index] != attempt) {
+            index++;
+        }
+        us_internal_connect_race_drop_attempt(race, index, 1);
+
+        /* The next attempt starts right away, s is still in the race */
+        if (us_internal_connect_race_start_attempt(race)) {
+            us_internal_connect_race_schedule(race);
+        }
+        return 0;
+    }
+
+    /* The socket of the app takes over the oldest attempt in flight or starts the next one itself */
+    int took_over = race->num_attempts != 0;
+    LIBUS_SOCKET_DESCRIPTOR fd;
+    if (took_over) {
+        fd = us_poll_fd(&race->attempts[0]->p);
+        us_internal_connect_race_drop_attempt(race, 0, 0);
+    } else {
+        fd = us_internal_connect_race_next_fd(race);
+    }
+    if (fd == LIBUS_SOCKET_ERROR) {
+        us_internal_connect_race_cancel(s);
+        return s;
+    }
+    us_internal_connect_race_replace_fd(s, fd);
+
+    if (took_over) {
+        us_internal_connect_race_start_attempt(race);
     }
+    us_internal_connect_race_schedule(race);
+    return 0;
+}
+
 #endif
 
-    LIBUS_SOCKET_DESCRIPTOR connect_socket_fd = bsd_create_connect_socket(host, port, source_host, options);
-    if (connect_socket_fd == LIBUS_SOCKET_ERROR) {
+int us_internal_socket_connect_resolved(struct us_socket_t *s, struct addrinfo *result, struct addrinfo *source_result, int options) {
+#ifdef LIBUS_USE_HAPPY_EYEBALLS
+    struct us_internal_connect_race_t *race = malloc(sizeof(struct us_internal_connect_race_t));
+    if (!race) {
         return 0;
     }
+    race->num_addresses = bsd_connect_addresses(result, source_result, race->addresses, CONNECT_RACE_MAX_ADDRESSES, &race->source);
+    race->next_address = 0;
+    race->num_attempts = 0;
+    /* A Fast Open attempt is writable before its handshake, so it would win any race even if its address cannot
+     * be reached. Racing takes precedence */
+    race->options = race->num_addresses > 1 ? options & ~LIBUS_CONNECT_FAST_OPEN : options;
+
+    LIBUS_SOCKET_DESCRIPTOR fd = us_internal_connect_race_next_fd(race);
+    if (fd == LIBUS_SOCKET_ERROR) {
+        free(race);
+        return 0;
+    }
+    us_poll_init(&s->p, fd, POLL_TYPE_SEMI_SOCKET);
+    us_poll_start(&s->p, s->context->loop, LIBUS_SOCKET_WRITABLE);
+
+    /* A single address has nothing to race */
+    struct us_internal_socket_aux_t *aux = race->next_address < race->num_addresses ? us_internal_socket_aux(s) : 0;
+    if (aux) {
+        race->timer = us_create_timer(s->context->loop, 0, sizeof(struct us_internal_connect_race_t *));
+    }
+    if (!aux || !race->timer) {
+        free(race);
+        return 1;
+    }
+    race->s = s;
+    *(struct us_internal_connect_race_t **) us_timer_ext(race->timer) = race;
+    aux->connect_race = race;
+    us_internal_connect_race_schedule(race);
+#else
+    LIBUS_SOCKET_DESCRIPTOR fd = bsd_create_connect_socket_resolved(result, source_result, options);
+    if (fd == LIBUS_SOCKET_ERROR) {
+        return 0;
+    }
+    us_poll_init(&s->p, fd, POLL_TYPE_SEMI_SOCKET);
+    us_poll_start(&s->p, s->context->loop, LIBUS_SOCKET_WRITABLE);
+#endif
+    return 1;
+}
 
+/* A connecting socket without descriptor, not yet linked into its context */
+static struct us_socket_t *us_internal_create_connect_socket(struct us_socket_context_t *context, int socket_ext_size) {
     /* Connect sockets are semi-sockets just like listen sockets */
     struct us_poll_t *p = us_create_poll(context->loop, 0, sizeof(struct us_socket_t) + socket_ext_size);
-    us_poll_init(p, connect_socket_fd, POLL_TYPE_SEMI_SOCKET);
-    us_poll_start(p, context->loop, LIBUS_SOCKET_WRITABLE);
+    us_poll_init(p, LIBUS_SOCKET_ERROR, POLL_TYPE_SEMI_SOCKET);
 
     struct us_socket_t *connect_socket = (struct us_socket_t *) p;
 
@@ -336,7 +822,60 @@ struct us_socket_t *us_socket_context_connect(int ssl, struct us_socket_context_
     connect_socket->timeout = 255;
     connect_socket->long_timeout = 255;
     connect_socket->low_prio_state = 0;
+    connect_socket->aux = 0;
+    connect_socket->flags = 0;
+    connect_socket->read_shift = 0;
+    return connect_socket;
+}
+
+struct us_socket_t *us_socket_context_connect(int ssl, struct us_socket_context_t *context, const char *host, int port, const char *source_host, int options, int socket_ext_size) {
+#ifndef LIBUS_NO_SSL
+    if (ssl) {
+        return (struct us_socket_t *) us_internal_ssl_socket_context_connect((struct us_internal_ssl_socket_context_t *) context, host, port, source_host, options, socket_ext_size);
+    }
+#endif
+
+    if (us_internal_socket_context_reject(context, 1)) {
+        return 0;
+    }
+
+    struct us_socket_t *connect_socket = us_internal_create_connect_socket(context, socket_ext_size);
+
+    /* Host names not in the DNS cache are resolved off the loop thread, the socket gets its descriptor once that is done */
+    if (!us_internal_socket_connect(connect_socket, host, port, source_host, options)) {
+        free(connect_socket->aux);
+        us_poll_free(&connect_socket->p, context->loop);
+        return 0;
+    }
+    us_internal_socket_context_link_socket(context, connect_socket);
+    US_METRIC_ADD(context->loop, sockets, 1);
+
+    return connect_socket;
+}
+
+/* Same as above for an address resolved already, without racing others */
+struct us_socket_t *us_internal_socket_context_connect_addr(int ssl, struct us_socket_context_t *context, struct bsd_addr_t *addr,
+    struct bsd_addr_t *source, int options, int socket_ext_size) {
+#ifndef LIBUS_NO_SSL
+    if (ssl) {
+        return (struct us_socket_t *) us_internal_ssl_socket_context_connect_addr((struct us_internal_ssl_socket_context_t *) context, addr, source, options, socket_ext_size);
+    }
+#endif
+
+    if (us_internal_socket_context_reject(context, 1)) {
+        return 0;
+    }
+
+    LIBUS_SOCKET_DESCRIPTOR fd = bsd_create_connect_socket_addr(addr, source, options);
+    if (fd == LIBUS_SOCKET_ERROR) {
+        return 0;
+    }
+
+    struct us_socket_t *connect_socket = us_internal_create_connect_socket(context, socket_ext_size);
+    us_poll_init(&connect_socket->p, fd, POLL_TYPE_SEMI_SOCKET);
+    us_poll_start(&connect_socket->p, context->loop, LIBUS_SOCKET_WRITABLE);
     us_internal_socket_context_link_socket(context, connect_socket);
+    US_METRIC_ADD(context->loop, sockets, 1);
 
     return connect_socket;
 }
@@ -348,6 +887,10 @@ struct us_socket_t *us_socket_context_connect_unix(int ssl, struct us_socket_con
     }
 #endif
 
+    if (us_internal_socket_context_reject(context, 1)) {
+        return 0;
+    }
+
     LIBUS_SOCKET_DESCRIPTOR connect_socket_fd = bsd_create_connect_socket_unix(server_path, options);
     if (connect_socket_fd == LIBUS_SOCKET_ERROR) {
         return 0;
@@ -365,7 +908,11 @@ struct us_socket_t *us_socket_context_connect_unix(int ssl, struct us_socket_con
     connect_socket->timeout = 255;
     connect_socket->long_timeout = 255;
     connect_socket->low_prio_state = 0;
+    connect_socket->aux = 0;
+    connect_socket->flags = 0;
+    connect_socket->read_shift = 0;
     us_internal_socket_context_link_socket(context, connect_socket);
+    US_METRIC_ADD(context->loop, sockets, 1);
 
     return connect_socket;
 }
@@ -410,10 +957,31 @@ struct us_socket_t *us_socket_context_adopt_socket(int ssl, struct us_socket_con
         else new_s->prev->next = new_s;
 
         if (new_s->next) new_s->next->prev = new_s;
+
+        /* Linked into the new context once dequeued, counted there from now on */
+        us_internal_socket_context_count(new_s->context, new_s, -1);
+        new_s->context = context;
+        us_internal_socket_context_count(context, new_s, 1);
     } else {
         us_internal_socket_context_link_socket(context, new_s);
     }
 
+    /* The pipe peer keeps a pointer to us */
+    if (new_s->aux && new_s->aux->pipe_peer) {
+        new_s->aux->pipe_peer->aux->pipe_peer = new_s;
+    }
+
+    /* So does a pending host name resolution */
+    if (new_s->aux && new_s->aux->resolve_request) {
+        us_internal_socket_resolve_adopt(new_s);
+    }
+#ifdef LIBUS_USE_HAPPY_EYEBALLS
+    /* And the race of its connect attempts */
+    if (new_s->aux && new_s->aux->connect_race) {
+        us_internal_connect_race_adopt(new_s);
+    }
+#endif
+
     return new_s;
 }
 
@@ -511,6 +1079,15 @@ void us_socket_context_on_connect_error(int ssl, struct us_socket_context_t *con
     context->on_connect_error = on_connect_error;
 }
 
+void us_socket_context_on_fds(int ssl, struct us_socket_context_t *context, struct us_socket_t *(*on_fds)(struct us_socket_t *s, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds)) {
+    /* Descriptors cannot travel inside an encrypted stream */
+    if (ssl) {
+        return;
+    }
+
+    context->on_fds = on_fds;
+}
+
 void *us_socket_context_ext(int ssl, struct us_socket_context_t *context) {
 #ifndef LIBUS_NO_SSL
     if (ssl) {
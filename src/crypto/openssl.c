@@ -55,6 +55,9 @@ struct loop_ssl_data {
     BIO *shared_rbio;
     BIO *shared_wbio;
     BIO_METHOD *shared_biom;
+
+    /* Resumed sockets with data held back while paused, replayed next iteration */
+    struct us_internal_ssl_socket_t *replay_head;
 };
 
 struct us_internal_ssl_socket_context_t {
@@ -85,6 +88,14 @@ struct us_internal_ssl_socket_t {
     SSL *ssl;
     int ssl_write_wants_read; // we use this for now
     int ssl_read_wants_write;
+    /* Counted in num_handshaking of its context until the handshake is done */
+    int handshaking;
+
+    /* Ciphertext we did not get to because the app paused us from within on_data */
+    char *held_input;
+    unsigned int held_input_length;
+    int replay_queued;
+    struct us_internal_ssl_socket_t *replay_next;
 };
 
 int passphrase_cb(char *buf, int size, int rwflag, void *u) {
@@ -157,6 +168,11 @@ struct us_internal_ssl_socket_t *ssl_on_open(struct us_internal_ssl_socket_t *s,
     s->ssl = SSL_new(context->ssl_context);
     s->ssl_write_wants_read = 0;
     s->ssl_read_wants_write = 0;
+    s->held_input = 0;
+    s->held_input_length = 0;
+    s->replay_queued = 0;
+    s->handshaking = 1;
+    context->sc.num_handshaking++;
     SSL_set_bio(s->ssl, loop_ssl_data->shared_rbio, loop_ssl_data->shared_wbio);
 
     BIO_up_ref(loop_ssl_data->shared_rbio);
@@ -171,6 +187,42 @@ struct us_internal_ssl_socket_t *ssl_on_open(struct us_internal_ssl_socket_t *s,
     return (struct us_internal_ssl_socket_t *) context->on_open(s, is_client, ip, ip_length);
 }
 
+/* Replaces old_s with new_s in the replay queue, or unlinks it if new_s is null */
+static void ssl_update_replay_queue(struct us_internal_ssl_socket_t *old_s, struct us_internal_ssl_socket_t *new_s) {
+    struct us_loop_t *loop = us_socket_context_loop(0, us_socket_context(0, &(new_s ? new_s : old_s)->s));
+    struct loop_ssl_data *loop_ssl_data = (struct loop_ssl_data *) loop->data.ssl_data;
+
+    for (struct us_internal_ssl_socket_t **it = &loop_ssl_data->replay_head; *it; it = &(*it)->replay_next) {
+        if (*it == old_s) {
+            *it = new_s ? new_s : old_s->replay_next;
+            return;
+        }
+    }
+}
+
+/* Keeps what is left of the current input since the app paused us from within on_data */
+static void ssl_hold_input(struct us_internal_ssl_socket_t *s, struct loop_ssl_data *loop_ssl_data) {
+    char *remaining = loop_ssl_data->ssl_read_input + loop_ssl_data->ssl_read_input_offset;
+    unsigned int length = loop_ssl_data->ssl_read_input_length;
+
+    if (loop_ssl_data->ssl_read_input != s->held_input) {
+        /* Anything held was merged into the input we got */
+        free(s->held_input);
+        s->held_input = length ? malloc(length) : 0;
+        if (length) {
+            memcpy(s->held_input, remaining, length);
+        }
+    } else if (length) {
+        memmove(s->held_input, remaining, length);
+    } else {
+        free(s->held_input);
+        s->held_input = 0;
+    }
+    s->held_input_length = length;
+
+    loop_ssl_data->ssl_read_input_length = 0;
+}
+
 /* This one is a helper; it is entirely shared with non-SSL so can be removed */
 struct us_internal_ssl_socket_t *us_internal_ssl_socket_close(struct us_internal_ssl_socket_t *s, int code, void *reason) {
     return (struct us_internal_ssl_socket_t *) us_socket_close(0, (struct us_socket_t *) s, code, reason);
@@ -181,6 +233,15 @@ struct us_internal_ssl_socket_t *ssl_on_close(struct us_internal_ssl_socket_t *s
 
     SSL_free(s->ssl);
 
+    if (s->handshaking) {
+        context->sc.num_handshaking--;
+    }
+
+    free(s->held_input);
+    if (s->replay_queued) {
+        ssl_update_replay_queue(s, 0);
+    }
+
     return context->on_close(s, code, reason);
 }
 
@@ -201,6 +262,17 @@ struct us_internal_ssl_socket_t *ssl_on_data(struct us_internal_ssl_socket_t *s,
     struct us_loop_t *loop = us_socket_context_loop(0, &context->sc);
     struct loop_ssl_data *loop_ssl_data = (struct loop_ssl_data *) loop->data.ssl_data;
 
+    /* Ciphertext held back while paused goes before anything new */
+    if (s->held_input) {
+        if (length) {
+            s->held_input = realloc(s->held_input, s->held_input_length + length);
+            memcpy(s->held_input + s->held_input_length, data, length);
+            s->held_input_length += length;
+        }
+        data = s->held_input;
+        length = s->held_input_length;
+    }
+
     // note: if we put data here we should never really clear it (not in write either, it still should be available for SSL_write to read from!)
     loop_ssl_data->ssl_read_input = data;
     loop_ssl_data->ssl_read_input_length = length;
@@ -236,7 +308,12 @@ struct us_internal_ssl_socket_t *ssl_on_data(struct us_internal_ssl_socket_t *s,
     int read = 0;
     restart:
     while (1) {
-        int just_read = SSL_read(s->ssl, loop_ssl_data->ssl_read_output + LIBUS_RECV_BUFFER_PADDING + read, LIBUS_RECV_BUFFER_LENGTH - read);
+        int just_read = SSL_read(s->ssl, loop_ssl_data->ssl_read_output + LIBUS_RECV_BUFFER_PADDING + read, loop->data.recv_buf_length - read);
+
+        if (s->handshaking && !SSL_in_init(s->ssl)) {
+            s->handshaking = 0;
+            us_socket_context(0, &s->s)->num_handshaking--;
+        }
 
         if (just_read <= 0) {
             int err = SSL_get_error(s->ssl, just_read);
@@ -284,21 +361,40 @@ struct us_internal_ssl_socket_t *ssl_on_data(struct us_internal_ssl_socket_t *s,
         read += just_read;
 
         // at this point we might be full and need to emit the data to application and start over
-        if (read == LIBUS_RECV_BUFFER_LENGTH) {
+        if (read == loop->data.recv_buf_length) {
 
             context = (struct us_internal_ssl_socket_context_t *) us_socket_context(0, &s->s);
 
             // emit data and restart
+            unsigned int input_offset = loop_ssl_data->ssl_read_input_offset, input_length = loop_ssl_data->ssl_read_input_length;
             s = context->on_data(s, loop_ssl_data->ssl_read_output + LIBUS_RECV_BUFFER_PADDING, read);
             if (us_socket_is_closed(0, &s->s)) {
                 return s;
             }
 
+            /* Writing from within on_data resets the shared input, but we are not done with it */
+            loop_ssl_data->ssl_read_input = data;
+            loop_ssl_data->ssl_read_input_offset = input_offset;
+            loop_ssl_data->ssl_read_input_length = input_length;
+            loop_ssl_data->ssl_socket = &s->s;
+
+            if (s->s.flags & SOCKET_FLAG_PAUSED) {
+                ssl_hold_input(s, loop_ssl_data);
+                return s;
+            }
+
             read = 0;
             goto restart;
         }
     }
 
+    /* Anything held back is consumed by now */
+    if (s->held_input) {
+        free(s->held_input);
+        s->held_input = 0;
+        s->held_input_length = 0;
+    }
+
     // trigger writable if we failed last write with want read
     if (s->ssl_write_wants_read) {
         s->ssl_write_wants_read = 0;
@@ -355,7 +451,7 @@ void us_internal_init_loop_ssl_data(struct us_loop_t *loop) {
     if (!loop->data.ssl_data) {
         struct loop_ssl_data *loop_ssl_data = malloc(sizeof(struct loop_ssl_data));
 
-        loop_ssl_data->ssl_read_output = malloc(LIBUS_RECV_BUFFER_LENGTH + LIBUS_RECV_BUFFER_PADDING * 2);
+        loop_ssl_data->ssl_read_output = malloc(loop->data.recv_buf_length + LIBUS_RECV_BUFFER_PADDING * 2);
 
         OPENSSL_init_ssl(0, NULL);
 
@@ -370,6 +466,8 @@ void us_internal_init_loop_ssl_data(struct us_loop_t *loop) {
         BIO_set_data(loop_ssl_data->shared_rbio, loop_ssl_data);
         BIO_set_data(loop_ssl_data->shared_wbio, loop_ssl_data);
 
+        loop_ssl_data->replay_head = 0;
+
         loop->data.ssl_data = loop_ssl_data;
     }
 }
@@ -390,6 +488,22 @@ void us_internal_free_loop_ssl_data(struct us_loop_t *loop) {
     }
 }
 
+/* Called before every iteration, emits what resumed sockets held back while paused */
+void us_internal_ssl_replay_held(struct us_loop_t *loop) {
+    struct loop_ssl_data *loop_ssl_data = (struct loop_ssl_data *) loop->data.ssl_data;
+
+    while (loop_ssl_data && loop_ssl_data->replay_head) {
+        struct us_internal_ssl_socket_t *s = loop_ssl_data->replay_head;
+        loop_ssl_data->replay_head = s->replay_next;
+        s->replay_queued = 0;
+
+        /* Paused again before we got to it, the next resume queues it again */
+        if (!(s->s.flags & SOCKET_FLAG_PAUSED)) {
+            ssl_on_data(s, 0, 0);
+        }
+    }
+}
+
 // we throttle reading data for ssl sockets that are in init state. here we actually use
 // the kernel buffering to our advantage
 int ssl_is_low_prio(struct us_internal_ssl_socket_t *s) {
@@ -694,15 +808,23 @@ struct us_listen_socket_t *us_internal_ssl_socket_context_listen_unix(struct us_
     return us_socket_context_listen_unix(0, &context->sc, path, options, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + socket_ext_size);
 }
 
+struct us_listen_socket_t *us_internal_ssl_socket_context_adopt_listen_socket(struct us_internal_ssl_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR fd, int socket_ext_size) {
+    return us_socket_context_adopt_listen_socket(0, &context->sc, fd, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + socket_ext_size);
+}
+
 struct us_internal_ssl_socket_t *us_internal_ssl_adopt_accepted_socket(struct us_internal_ssl_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR accepted_fd,
-    unsigned int socket_ext_size, char *addr_ip, int addr_ip_length) {
-    return (struct us_internal_ssl_socket_t *) us_adopt_accepted_socket(0, &context->sc, accepted_fd, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + socket_ext_size, addr_ip, addr_ip_length);
+    unsigned int socket_ext_size, char *addr_ip, int addr_ip_length, unsigned int source) {
+    return (struct us_internal_ssl_socket_t *) us_internal_adopt_accepted_socket(&context->sc, accepted_fd, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + socket_ext_size, addr_ip, addr_ip_length, source);
 }
 
 struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_connect(struct us_internal_ssl_socket_context_t *context, const char *host, int port, const char *source_host, int options, int socket_ext_size) {
     return (struct us_internal_ssl_socket_t *) us_socket_context_connect(0, &context->sc, host, port, source_host, options, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + socket_ext_size);
 }
 
+struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_connect_addr(struct us_internal_ssl_socket_context_t *context, struct bsd_addr_t *addr, struct bsd_addr_t *source, int options, int socket_ext_size) {
+    return (struct us_internal_ssl_socket_t *) us_internal_socket_context_connect_addr(0, &context->sc, addr, source, options, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + socket_ext_size);
+}
+
 struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_connect_unix(struct us_internal_ssl_socket_context_t *context, const char *server_path, int options, int socket_ext_size) {
     return (struct us_internal_ssl_socket_t *) us_socket_context_connect_unix(0, &context->sc, server_path, options, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + socket_ext_size);
 }
@@ -852,7 +974,31 @@ void us_internal_ssl_socket_shutdown(struct us_internal_ssl_socket_t *s) {
 
 struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_adopt_socket(struct us_internal_ssl_socket_context_t *context, struct us_internal_ssl_socket_t *s, int ext_size) {
     // todo: this is completely untested
-    return (struct us_internal_ssl_socket_t *) us_socket_context_adopt_socket(0, &context->sc, &s->s, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + ext_size);
+    struct us_socket_context_t *old_context = us_socket_context(0, &s->s);
+    struct us_internal_ssl_socket_t *new_s = (struct us_internal_ssl_socket_t *) us_socket_context_adopt_socket(0, &context->sc, &s->s, sizeof(struct us_internal_ssl_socket_t) - sizeof(struct us_socket_t) + ext_size);
+
+    if (new_s != s && new_s->replay_queued) {
+        ssl_update_replay_queue(s, new_s);
+    }
+
+    if (new_s->handshaking && old_context != &context->sc) {
+        old_context->num_handshaking--;
+        context->sc.num_handshaking++;
+    }
+
+    return new_s;
+}
+
+void us_internal_ssl_socket_resume(struct us_internal_ssl_socket_t *s) {
+    /* Emitting from here could clobber the shared read buffers of an ssl_on_data further up the stack */
+    if (!s->replay_queued && (s->held_input || SSL_pending(s->ssl) > 0)) {
+        struct us_loop_t *loop = us_socket_context_loop(0, us_socket_context(0, &s->s));
+        struct loop_ssl_data *loop_ssl_data = (struct loop_ssl_data *) loop->data.ssl_data;
+
+        s->replay_next = loop_ssl_data->replay_head;
+        loop_ssl_data->replay_head = s;
+        s->replay_queued = 1;
+    }
 }
 
 #endif
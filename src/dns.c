@@ -0,0 +1,681 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LIBUS_USE_ASYNC_DNS
+#include <pthread.h>
+static void us_internal_resolve_request_free(struct us_internal_resolve_request_t *req);
+#endif
+
+/* Per-loop cache of what host names of outbound connects resolved to. Only the loop thread touches it.
+ * A name being resolved has an entry too, so that connects to it wait for that resolution instead of
+ * starting their own */
+
+#define DNS_CACHE_BUCKETS 256
+
+#ifndef LIBUS_DNS_CACHE_MAX_ENTRIES
+#define LIBUS_DNS_CACHE_MAX_ENTRIES 1024
+#endif
+
+struct us_internal_dns_cache_entry_t {
+    struct us_internal_dns_cache_entry_t *next;
+    char *host;
+    int port;
+    /* Null for names that do not exist */
+    struct addrinfo *result;
+    /* us_internal_now_ns, which the wall clock moving does not affect */
+    long long expires;
+    int resolving;
+    /* Requests of sockets waiting for the resolution in flight, linked through next */
+    struct us_internal_resolve_request_t *waiters;
+};
+
+struct us_internal_dns_cache_t {
+    /* Disabled while 0, resolving entries still finish */
+    unsigned int ttl, negative_ttl;
+    struct us_internal_dns_cache_entry_t *buckets[DNS_CACHE_BUCKETS];
+    int length;
+    struct us_dns_cache_stats_t stats;
+};
+
+static struct us_internal_dns_cache_entry_t **us_internal_dns_cache_find(struct us_internal_dns_cache_t *cache, const char *host, int port) {
+    /* FNV-1a */
+    unsigned int hash = 2166136261u ^ (unsigned int) port;
+    for (const char *c = host; *c; c++) {
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    }
+
+    struct us_internal_dns_cache_entry_t **link = &cache->buckets[hash % DNS_CACHE_BUCKETS];
+    while (*link && ((*link)->port != port || strcmp((*link)->host, host))) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void us_internal_dns_cache_remove(struct us_internal_dns_cache_t *cache, struct us_internal_dns_cache_entry_t **link) {
+    struct us_internal_dns_cache_entry_t *entry = *link;
+    *link = entry->next;
+    cache->length--;
+
+    if (entry->result) {
+        bsd_free_addrinfo(entry->result);
+    }
+    free(entry->host);
+    free(entry);
+}
+
+/* Drops expired entries, or the one expiring first if none did */
+static void us_internal_dns_cache_make_room(struct us_internal_dns_cache_t *cache) {
+    long long now = us_internal_now_ns();
+    struct us_internal_dns_cache_entry_t **first_expiring = 0;
+
+    for (int i = 0; i < DNS_CACHE_BUCKETS; i++) {
+        struct us_internal_dns_cache_entry_t **link = &cache->buckets[i];
+        while (*link) {
+            if ((*link)->resolving) {
+                link = &(*link)->next;
+            } else if ((*link)->expires <= now) {
+                us_internal_dns_cache_remove(cache, link);
+                first_expiring = 0;
+            } else {
+                if (!first_expiring || (*link)->expires < (*first_expiring)->expires) {
+                    first_expiring = link;
+                }
+                link = &(*link)->next;
+            }
+        }
+    }
+
+    if (cache->length >= LIBUS_DNS_CACHE_MAX_ENTRIES && first_expiring) {
+        us_internal_dns_cache_remove(cache, first_expiring);
+    }
+}
+
+static struct us_internal_dns_cache_entry_t *us_internal_dns_cache_insert(struct us_internal_dns_cache_t *cache, const char *host, int port) {
+    if (cache->length >= LIBUS_DNS_CACHE_MAX_ENTRIES) {
+        us_internal_dns_cache_make_room(cache);
+        if (cache->length >= LIBUS_DNS_CACHE_MAX_ENTRIES) {
+            return 0;
+        }
+    }
+
+    struct us_internal_dns_cache_entry_t *entry = calloc(1, sizeof(struct us_internal_dns_cache_entry_t));
+    if (!entry || !(entry->host = strdup(host))) {
+        free(entry);
+        return 0;
+    }
+    entry->port = port;
+
+    struct us_internal_dns_cache_entry_t **link = us_internal_dns_cache_find(cache, host, port);
+    entry->next = *link;
+    *link = entry;
+    cache->length++;
+    return entry;
+}
+
+/* Stores what a name resolved to. Returns 1 if the entry took over result, otherwise the entry is removed */
+static int us_internal_dns_cache_store(struct us_internal_dns_cache_t *cache, struct us_internal_dns_cache_entry_t **link,
+    struct addrinfo *result, int error) {
+    struct us_internal_dns_cache_entry_t *entry = *link;
+    entry->resolving = 0;
+    entry->waiters = 0;
+
+    /* Temporary failures are not cached */
+    unsigned int ttl = error ? (bsd_resolve_error_is_permanent(error) ? cache->negative_ttl : 0) : cache->ttl;
+    if (!ttl || !cache->ttl) {
+        us_internal_dns_cache_remove(cache, link);
+        return 0;
+    }
+    entry->result = result;
+    entry->expires = us_internal_now_ns() + ttl * 1000000000LL;
+    return 1;
+}
+
+void us_loop_set_dns_cache(struct us_loop_t *loop, unsigned int ttl, unsigned int negative_ttl) {
+    struct us_internal_dns_cache_t *cache = loop->data.dns_cache;
+    if (!cache) {
+        if (!ttl) {
+            return;
+        }
+        cache = loop->data.dns_cache = calloc(1, sizeof(struct us_internal_dns_cache_t));
+        if (!cache) {
+            return;
+        }
+    }
+
+    cache->ttl = ttl;
+    cache->negative_ttl = ttl ? negative_ttl : 0;
+
+    /* Flush what is cached, entries still resolving go away once they resolve */
+    if (!ttl) {
+        for (int i = 0; i < DNS_CACHE_BUCKETS; i++) {
+            struct us_internal_dns_cache_entry_t **link = &cache->buckets[i];
+            while (*link) {
+                if ((*link)->resolving) {
+                    link = &(*link)->next;
+                } else {
+                    us_internal_dns_cache_remove(cache, link);
+                }
+            }
+        }
+    }
+}
+
+void us_loop_dns_cache_stats(struct us_loop_t *loop, struct us_dns_cache_stats_t *stats) {
+    struct us_internal_dns_cache_t *cache = loop->data.dns_cache;
+    if (cache) {
+        *stats = cache->stats;
+        stats->entries = cache->length;
+    } else {
+        memset(stats, 0, sizeof(struct us_dns_cache_stats_t));
+    }
+}
+
+void us_internal_dns_cache_free(struct us_loop_t *loop) {
+    struct us_internal_dns_cache_t *cache = loop->data.dns_cache;
+    if (!cache) {
+        return;
+    }
+    loop->data.dns_cache = 0;
+
+    for (int i = 0; i < DNS_CACHE_BUCKETS; i++) {
+        while (cache->buckets[i]) {
+#ifdef LIBUS_USE_ASYNC_DNS
+            while (cache->buckets[i]->waiters) {
+                struct us_internal_resolve_request_t *waiter = cache->buckets[i]->waiters;
+                cache->buckets[i]->waiters = *(struct us_internal_resolve_request_t **) waiter;
+                us_internal_resolve_request_free(waiter);
+            }
+#endif
+            us_internal_dns_cache_remove(cache, &cache->buckets[i]);
+        }
+    }
+    free(cache);
+}
+
+#ifdef LIBUS_USE_ASYNC_DNS
+
+/* getaddrinfo blocks for as long as the resolver takes, so connecting sockets hand their host names to a
+ * process-wide pool of threads. Results come back to the loop through an async which only exists (and keeps
+ * the loop alive) while resolutions are pending. A connecting socket has no descriptor until then. */
+
+#ifndef LIBUS_RESOLVER_THREADS
+#define LIBUS_RESOLVER_THREADS 4
+#endif
+
+struct us_internal_resolve_request_t {
+    /* Must be first, cache entries link waiters through it */
+    struct us_internal_resolve_request_t *next;
+    struct us_internal_resolver_t *resolver;
+    /* Only touched on the loop thread, null once the socket is closed */
+    struct us_socket_t *s;
+    char *host, *source_host;
+    int port, options;
+    /* Whether the result goes into the cache, and other sockets wait for it there */
+    int cached;
+    struct addrinfo *result, *source_result;
+    int error;
+};
+
+/* Per loop, outlives the loop if it is freed with resolutions pending */
+struct us_internal_resolver_t {
+    pthread_mutex_t mutex;
+    struct us_internal_async *async;
+    struct us_internal_resolve_request_t *done_head;
+    int pending;
+    int orphaned;
+};
+
+/* The thread pool, shared by all loops */
+static pthread_mutex_t resolver_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resolver_pool_cond = PTHREAD_COND_INITIALIZER;
+static struct us_internal_resolve_request_t *resolver_pool_head, *resolver_pool_tail;
+static int resolver_pool_threads, resolver_pool_idle;
+
+static void us_internal_resolve_request_free(struct us_internal_resolve_request_t *req) {
+    if (req->result) {
+        bsd_free_addrinfo(req->result);
+    }
+    if (req->source_result) {
+        bsd_free_addrinfo(req->source_result);
+    }
+    free(req->host);
+    free(req->source_host);
+    free(req);
+}
+
+static void us_internal_resolver_finish(struct us_internal_resolve_request_t *req) {
+    struct us_internal_resolver_t *resolver = req->resolver;
+    int destroy = 0;
+
+    pthread_mutex_lock(&resolver->mutex);
+    if (resolver->orphaned) {
+        us_internal_resolve_request_free(req);
+        destroy = !--resolver->pending;
+    } else {
+        req->next = resolver->done_head;
+        resolver->done_head = req;
+        us_internal_async_wakeup(resolver->async);
+    }
+    pthread_mutex_unlock(&resolver->mutex);
+
+    if (destroy) {
+        pthread_mutex_destroy(&resolver->mutex);
+        free(resolver);
+    }
+}
+
+static void *us_internal_resolver_thread(void *arg) {
+    pthread_mutex_lock(&resolver_pool_mutex);
+    while (1) {
+        while (!resolver_pool_head) {
+            resolver_pool_idle++;
+            pthread_cond_wait(&resolver_pool_cond, &resolver_pool_mutex);
+            resolver_pool_idle--;
+        }
+
+        struct us_internal_resolve_request_t *req = resolver_pool_head;
+        resolver_pool_head = req->next;
+        if (!resolver_pool_head) {
+            resolver_pool_tail = 0;
+        }
+        pthread_mutex_unlock(&resolver_pool_mutex);
+
+        req->error = bsd_resolve_connect_host(req->host, req->port, &req->result);
+        if (req->error) {
+            req->result = 0;
+        } else if (req->source_host && bsd_resolve_source_host(req->source_host, &req->source_result)) {
+            req->source_result = 0;
+        }
+        us_internal_resolver_finish(req);
+
+        pthread_mutex_lock(&resolver_pool_mutex);
+    }
+    return 0;
+}
+
+/* Returns 0 if no thread could be started to take the request */
+static int us_internal_resolver_pool_submit(struct us_internal_resolve_request_t *req) {
+    pthread_mutex_lock(&resolver_pool_mutex);
+
+    /* Grow the pool until every queued request has a thread or we hit the limit */
+    if (resolver_pool_idle == 0 && resolver_pool_threads < LIBUS_RESOLVER_THREADS) {
+        pthread_t thread;
+        if (!pthread_create(&thread, 0, us_internal_resolver_thread, 0)) {
+            pthread_detach(thread);
+            resolver_pool_threads++;
+        } else if (!resolver_pool_threads) {
+            pthread_mutex_unlock(&resolver_pool_mutex);
+            return 0;
+        }
+    }
+
+    req->next = 0;
+    if (resolver_pool_tail) {
+        resolver_pool_tail->next = req;
+    } else {
+        resolver_pool_head = req;
+    }
+    resolver_pool_tail = req;
+    pthread_cond_signal(&resolver_pool_cond);
+
+    pthread_mutex_unlock(&resolver_pool_mutex);
+    return 1;
+}
+
+/* Connects the sockets of a chain of requests for the same name, or fails them like any other connect.
+ * Errors are emitted only once every socket is done with result, as callbacks may flush the cache holding it */
+static void us_internal_resolve_complete(struct us_internal_resolve_request_t *reqs, struct addrinfo *result, int error) {
+    for (struct us_internal_resolve_request_t *req = reqs; req; req = req->next) {
+        struct us_socket_t *s = req->s;
+        if (!s) {
+            continue;
+        }
+
+        if (error || !us_internal_socket_connect_resolved(s, result, req->source_result, req->options)) {
+            continue;
+        }
+
+        s->aux->resolve_request = 0;
+        s->flags &= ~SOCKET_FLAG_RESOLVING;
+        req->s = 0;
+    }
+
+    for (struct us_internal_resolve_request_t *req = reqs; req; req = req->next) {
+        struct us_socket_t *s = req->s;
+        if (!s) {
+            continue;
+        }
+        s->aux->resolve_request = 0;
+        req->s = 0;
+
+        /* Emit error, close without emitting on_close. The socket still has nothing to stop or close */
+        s->context->on_connect_error(s, 0);
+        us_socket_close_connecting(0, s);
+    }
+}
+
+static void us_internal_resolver_async_cb(struct us_internal_async *a) {
+    /* Asyncs are called with the loop */
+    struct us_loop_t *loop = (struct us_loop_t *) a;
+    struct us_internal_resolver_t *resolver = loop->data.resolver;
+
+    pthread_mutex_lock(&resolver->mutex);
+    struct us_internal_resolve_request_t *done = resolver->done_head;
+    resolver->done_head = 0;
+    for (struct us_internal_resolve_request_t *req = done; req; req = req->next) {
+        resolver->pending--;
+    }
+
+    /* Without pending resolutions the async must not keep the loop alive */
+    if (!resolver->pending) {
+        us_internal_async_close(resolver->async);
+        resolver->async = 0;
+    }
+    pthread_mutex_unlock(&resolver->mutex);
+
+    while (done) {
+        struct us_internal_resolve_request_t *next = done->next;
+        struct addrinfo *result = done->result;
+        done->next = 0;
+
+        /* The cache takes over the result and hands us the sockets that waited for it */
+        if (done->cached) {
+            struct us_internal_dns_cache_entry_t **link = us_internal_dns_cache_find(loop->data.dns_cache, done->host, done->port);
+            if (*link) {
+                done->next = (*link)->waiters;
+                if (us_internal_dns_cache_store(loop->data.dns_cache, link, result, done->error)) {
+                    done->result = 0;
+                }
+            }
+        }
+
+        us_internal_resolve_complete(done, result, done->error);
+
+        while (done) {
+            struct us_internal_resolve_request_t *waiter = done->next;
+            us_internal_resolve_request_free(done);
+            done = waiter;
+        }
+        done = next;
+    }
+}
+
+static struct us_internal_resolver_t *us_internal_resolver(struct us_loop_t *loop) {
+    if (!loop->data.resolver) {
+        loop->data.resolver = calloc(1, sizeof(struct us_internal_resolver_t));
+        if (!loop->data.resolver) {
+            return 0;
+        }
+        pthread_mutex_init(&loop->data.resolver->mutex, 0);
+    }
+    return loop->data.resolver;
+}
+
+/* Counts a request as pending until it comes back through the async */
+static void us_internal_resolver_pend(struct us_loop_t *loop, struct us_internal_resolver_t *resolver) {
+    pthread_mutex_lock(&resolver->mutex);
+    if (!resolver->async) {
+        resolver->async = us_internal_create_async(loop, 0, 0);
+        us_internal_async_set(resolver->async, us_internal_resolver_async_cb);
+    }
+    resolver->pending++;
+    pthread_mutex_unlock(&resolver->mutex);
+}
+
+/* Fails a connect to a name cached as not existing the way a failed resolution does, in on_connect_error
+ * once the loop comes around rather than before connect returns */
+static int us_internal_socket_resolve_fail(struct us_socket_t *s, int options) {
+    struct us_loop_t *loop = s->context->loop;
+
+    struct us_internal_socket_aux_t *aux = us_internal_socket_aux(s);
+    struct us_internal_resolve_request_t *req = calloc(1, sizeof(struct us_internal_resolve_request_t));
+    struct us_internal_resolver_t *resolver = us_internal_resolver(loop);
+    if (!aux || !req || !resolver) {
+        free(req);
+        return 0;
+    }
+    req->s = s;
+    req->options = options;
+    req->resolver = resolver;
+    /* What the error was is not cached, only that it is permanent */
+    req->error = -1;
+
+    us_internal_resolver_pend(loop, resolver);
+    aux->resolve_request = req;
+    s->flags |= SOCKET_FLAG_RESOLVING;
+    us_internal_resolver_finish(req);
+    return 1;
+}
+
+int us_internal_socket_resolve(struct us_socket_t *s, const char *host, int port, const char *source_host, int options) {
+    struct us_loop_t *loop = s->context->loop;
+
+    struct us_internal_socket_aux_t *aux = us_internal_socket_aux(s);
+    struct us_internal_resolve_request_t *req = calloc(1, sizeof(struct us_internal_resolve_request_t));
+    if (!aux || !req) {
+        free(req);
+        return 0;
+    }
+    req->s = s;
+    req->options = options;
+
+    /* Wait for the resolution already in flight for this name */
+    struct us_internal_dns_cache_t *cache = loop->data.dns_cache;
+    if (cache && cache->ttl && !source_host) {
+        struct us_internal_dns_cache_entry_t *entry = *us_internal_dns_cache_find(cache, host, port);
+        if (entry && entry->resolving) {
+            req->next = entry->waiters;
+            entry->waiters = req;
+
+            aux->resolve_request = req;
+            s->flags |= SOCKET_FLAG_RESOLVING;
+            return 1;
+        }
+    }
+
+    struct us_internal_resolver_t *resolver = us_internal_resolver(loop);
+    if (!resolver) {
+        free(req);
+        return 0;
+    }
+
+    req->resolver = resolver;
+    req->host = strdup(host);
+    req->source_host = source_host ? strdup(source_host) : 0;
+    req->port = port;
+    if (!req->host || (source_host && !req->source_host)) {
+        us_internal_resolve_request_free(req);
+        return 0;
+    }
+
+    /* Later connects to this name wait for this resolution */
+    if (cache && cache->ttl && !source_host) {
+        struct us_internal_dns_cache_entry_t *entry = us_internal_dns_cache_insert(cache, host, port);
+        if (entry) {
+            entry->resolving = 1;
+            req->cached = 1;
+        }
+    }
+
+    us_internal_resolver_pend(loop, resolver);
+
+    if (!us_internal_resolver_pool_submit(req)) {
+        /* Nothing can complete it, so this request counts as done right away */
+        pthread_mutex_lock(&resolver->mutex);
+        if (!--resolver->pending) {
+            us_internal_async_close(resolver->async);
+            resolver->async = 0;
+        }
+        pthread_mutex_unlock(&resolver->mutex);
+        if (req->cached) {
+            us_internal_dns_cache_remove(cache, us_internal_dns_cache_find(cache, host, port));
+        }
+        us_internal_resolve_request_free(req);
+        return 0;
+    }
+
+    aux->resolve_request = req;
+    s->flags |= SOCKET_FLAG_RESOLVING;
+    return 1;
+}
+
+/* The result is dropped once it arrives */
+void us_internal_socket_resolve_cancel(struct us_socket_t *s) {
+    if (s->aux && s->aux->resolve_request) {
+        s->aux->resolve_request->s = 0;
+        s->aux->resolve_request = 0;
+    }
+}
+
+/* Called when a resolving socket moved in memory */
+void us_internal_socket_resolve_adopt(struct us_socket_t *s) {
+    s->aux->resolve_request->s = s;
+}
+
+void us_internal_resolver_free(struct us_loop_t *loop) {
+    struct us_internal_resolver_t *resolver = loop->data.resolver;
+    if (!resolver) {
+        return;
+    }
+    loop->data.resolver = 0;
+
+    /* Threads still resolving for this loop free what they finish and the last one frees the resolver */
+    pthread_mutex_lock(&resolver->mutex);
+    resolver->orphaned = 1;
+    if (resolver->async) {
+        us_internal_async_close(resolver->async);
+        resolver->async = 0;
+    }
+    while (resolver->done_head) {
+        struct us_internal_resolve_request_t *next = resolver->done_head->next;
+        us_internal_resolve_request_free(resolver->done_head);
+        resolver->done_head = next;
+        resolver->pending--;
+    }
+    int destroy = !resolver->pending;
+    pthread_mutex_unlock(&resolver->mutex);
+
+    if (destroy) {
+        pthread_mutex_destroy(&resolver->mutex);
+        free(resolver);
+    }
+}
+
+#else
+
+/* Without threads every host name is resolved on the loop thread */
+
+int us_internal_socket_resolve(struct us_socket_t *s, const char *host, int port, const char *source_host, int options) {
+    return 0;
+}
+
+void us_internal_socket_resolve_cancel(struct us_socket_t *s) {
+
+}
+
+void us_internal_socket_resolve_adopt(struct us_socket_t *s) {
+
+}
+
+void us_internal_resolver_free(struct us_loop_t *loop) {
+
+}
+
+#endif
+
+/* Gives a connecting socket its descriptor, or has it wait for its host name to resolve. Returns 0 on failure */
+int us_internal_socket_connect(struct us_socket_t *s, const char *host, int port, const char *source_host, int options) {
+    if (bsd_is_numeric_host(host) && (!source_host || bsd_is_numeric_host(source_host))) {
+        LIBUS_SOCKET_DESCRIPTOR fd = bsd_create_connect_socket(host, port, source_host, options);
+        if (fd == LIBUS_SOCKET_ERROR) {
+            return 0;
+        }
+        us_poll_init(&s->p, fd, POLL_TYPE_SEMI_SOCKET);
+        us_poll_start(&s->p, s->context->loop, LIBUS_SOCKET_WRITABLE);
+        return 1;
+    }
+
+    /* Names connected to with a source address are rare enough to not be cached */
+    struct us_internal_dns_cache_t *cache = s->context->loop->data.dns_cache;
+    if (cache && cache->ttl && !source_host) {
+        struct us_internal_dns_cache_entry_t **link = us_internal_dns_cache_find(cache, host, port);
+        if (*link && !(*link)->resolving && (*link)->expires <= us_internal_now_ns()) {
+            us_internal_dns_cache_remove(cache, link);
+        }
+
+        if (*link) {
+            if ((*link)->resolving) {
+                /* Joins the resolution in flight */
+                cache->stats.hits++;
+                return us_internal_socket_resolve(s, host, port, 0, options);
+            }
+            if (!(*link)->result) {
+                cache->stats.negative_hits++;
+#ifdef LIBUS_USE_ASYNC_DNS
+                return us_internal_socket_resolve_fail(s, options);
+#else
+                return 0;
+#endif
+            }
+            cache->stats.hits++;
+            return us_internal_socket_connect_resolved(s, (*link)->result, 0, options);
+        }
+        cache->stats.misses++;
+
+#ifndef LIBUS_USE_ASYNC_DNS
+        struct addrinfo *result;
+        int error = bsd_resolve_connect_host(host, port, &result);
+        if (error) {
+            result = 0;
+        }
+
+        int connected = result && us_internal_socket_connect_resolved(s, result, 0, options);
+        struct us_internal_dns_cache_entry_t *entry = us_internal_dns_cache_insert(cache, host, port);
+        if ((!entry || !us_internal_dns_cache_store(cache, us_internal_dns_cache_find(cache, host, port), result, error)) && result) {
+            bsd_free_addrinfo(result);
+        }
+        return connected;
+#endif
+    }
+
+#ifdef LIBUS_USE_ASYNC_DNS
+    return us_internal_socket_resolve(s, host, port, source_host, options);
+#else
+    struct addrinfo *result, *source_result = 0;
+    if (bsd_resolve_connect_host(host, port, &result)) {
+        return 0;
+    }
+    if (source_host && bsd_resolve_source_host(source_host, &source_result)) {
+        source_result = 0;
+    }
+
+    int connected = us_internal_socket_connect_resolved(s, result, source_result, options);
+    if (source_result) {
+        bsd_free_addrinfo(source_result);
+    }
+    bsd_free_addrinfo(result);
+    return connected;
+#endif
+}
+
+#endif
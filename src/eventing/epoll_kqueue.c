@@ -20,6 +20,7 @@
 #include "libusockets.h"
 #include "internal/internal.h"
 #include <stdlib.h>
+#include <errno.h>
 
 #if defined(LIBUS_USE_EPOLL) || defined(LIBUS_USE_KQUEUE)
 
@@ -117,15 +118,22 @@ void us_loop_run(struct us_loop_t *loop) {
 
     /* While we have non-fallthrough polls we shouldn't fall through */
     while (loop->num_polls) {
+        US_METRIC_CLOCK(iteration_start);
+
         /* Emit pre callback */
         us_internal_loop_pre(loop);
 
         /* Fetch ready polls */
+        US_METRIC_CLOCK(wait_start);
 #ifdef LIBUS_USE_EPOLL
         loop->num_ready_polls = epoll_wait(loop->fd, loop->ready_polls, 1024, -1);
 #else
         loop->num_ready_polls = kevent(loop->fd, NULL, 0, loop->ready_polls, 1024, NULL);
 #endif
+        US_METRIC_CLOCK(wait_end);
+        US_METRIC_ADD(loop, wait_ns, wait_end - wait_start);
+        US_PROBE2(ready, loop, loop->num_ready_polls);
+        us_internal_lag_ready(loop);
 
         /* Iterate ready polls, dispatching them by type */
         for (loop->current_ready_poll = 0; loop->current_ready_poll < loop->num_ready_polls; loop->current_ready_poll++) {
@@ -152,6 +160,9 @@ void us_loop_run(struct us_loop_t *loop) {
         }
         /* Emit post callback */
         us_internal_loop_post(loop);
+
+        US_METRIC_CLOCK(iteration_end);
+        US_METRIC_ADD(loop, dispatch_ns, (iteration_end - wait_end) + (wait_start - iteration_start));
     }
 }
 
@@ -160,16 +171,23 @@ void us_loop_run_once(struct us_loop_t *loop) {
         return;
     }
 
+    US_METRIC_CLOCK(iteration_start);
+
     /* Emit pre callback */
     us_internal_loop_pre(loop);
 
     /* Fetch ready polls */
+    US_METRIC_CLOCK(wait_start);
 #ifdef LIBUS_USE_EPOLL
     loop->num_ready_polls = epoll_wait(loop->fd, loop->ready_polls, 1024, 0);
 #else
     struct timespec timeout{0, 0};
     loop->num_ready_polls = kevent(loop->fd, NULL, 0, loop->ready_polls, 1024, &timeout);
 #endif
+    US_METRIC_CLOCK(wait_end);
+    US_METRIC_ADD(loop, wait_ns, wait_end - wait_start);
+    US_PROBE2(ready, loop, loop->num_ready_polls);
+    us_internal_lag_ready(loop);
 
     /* Iterate ready polls, dispatching them by type */
     for (loop->current_ready_poll = 0; loop->current_ready_poll < loop->num_ready_polls; loop->current_ready_poll++) {
@@ -196,6 +214,9 @@ void us_loop_run_once(struct us_loop_t *loop) {
     }
     /* Emit post callback */
     us_internal_loop_post(loop);
+
+    US_METRIC_CLOCK(iteration_end);
+    US_METRIC_ADD(loop, dispatch_ns, (iteration_end - wait_end) + (wait_start - iteration_start));
 }
 
 void us_internal_loop_update_pending_ready_polls(struct us_loop_t *loop, struct us_poll_t *old_poll, struct us_poll_t *new_poll, int old_events, int new_events) {
@@ -268,12 +289,26 @@ struct us_poll_t *us_poll_resize(struct us_poll_t *p, struct us_loop_t *loop, un
     return new_p;
 }
 
+#ifdef LIBUS_USE_EPOLL
+/* Shared listen sockets are polled by several loops. Only one of those waiting is woken per connection then,
+ * instead of all of them racing to accept it. Paused ones poll for nothing, which cannot be exclusive */
+static uint32_t us_internal_epoll_events(struct us_poll_t *p, int events) {
+#ifdef EPOLLEXCLUSIVE
+    if (events == LIBUS_SOCKET_READABLE && us_internal_poll_type(p) == POLL_TYPE_SEMI_SOCKET &&
+        (((struct us_socket_t *) p)->flags & SOCKET_FLAG_SHARED_LISTEN)) {
+        return events | EPOLLEXCLUSIVE;
+    }
+#endif
+    return events;
+}
+#endif
+
 void us_poll_start(struct us_poll_t *p, struct us_loop_t *loop, int events) {
     p->state.poll_type = us_internal_poll_type(p) | ((events & LIBUS_SOCKET_READABLE) ? POLL_TYPE_POLLING_IN : 0) | ((events & LIBUS_SOCKET_WRITABLE) ? POLL_TYPE_POLLING_OUT : 0);
 
 #ifdef LIBUS_USE_EPOLL
     struct epoll_event event;
-    event.events = events;
+    event.events = us_internal_epoll_events(p, events);
     event.data.ptr = p;
     epoll_ctl(loop->fd, EPOLL_CTL_ADD, p->state.fd, &event);
 #else
@@ -289,9 +324,13 @@ void us_poll_change(struct us_poll_t *p, struct us_loop_t *loop, int events) {
 
 #ifdef LIBUS_USE_EPOLL
         struct epoll_event event;
-        event.events = events;
+        event.events = us_internal_epoll_events(p, events);
         event.data.ptr = p;
-        epoll_ctl(loop->fd, EPOLL_CTL_MOD, p->state.fd, &event);
+        if (epoll_ctl(loop->fd, EPOLL_CTL_MOD, p->state.fd, &event) && errno == EINVAL) {
+            /* Exclusive registrations cannot be modified, only replaced */
+            epoll_ctl(loop->fd, EPOLL_CTL_DEL, p->state.fd, &event);
+            epoll_ctl(loop->fd, EPOLL_CTL_ADD, p->state.fd, &event);
+        }
 #else
         kqueue_change(loop->fd, p->state.fd, old_events, events, p);
 #endif
@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A plain socket context of its own serving GET /metrics. Loop counters and histograms are written by
+ * their loops with relaxed stores and read here the same way, so scraping takes no locks anywhere. */
+
+#define EXPORTER_TIMEOUT 30
+
+struct us_internal_exporter_context_t {
+    struct us_socket_context_t *context;
+    char *name;
+};
+
+struct us_metrics_exporter_t {
+    struct us_socket_context_t *context;
+    struct us_listen_socket_t *listen_socket;
+    struct us_loop_t **loops;
+    int num_loops;
+    struct us_internal_exporter_context_t *contexts;
+    int num_contexts;
+};
+
+/* A response still being written */
+struct us_internal_exporter_socket_t {
+    char *response;
+    int length;
+    int offset;
+};
+
+struct us_internal_exporter_text_t {
+    char *data;
+    int length;
+    int capacity;
+};
+
+static const char *callback_names[LIBUS_CALLBACK_TYPES] = {
+    "open", "data", "writable", "end", "connect_error", "timeout", "long_timeout"
+};
+
+static const char *reject_names[LIBUS_REJECT_TYPES] = {
+    "sockets", "connecting", "handshaking", "ip_rate", "ip_connections"
+};
+
+static const char *tcp_info_names[LIBUS_TCP_INFO_TYPES] = {
+    "usockets_tcp_rtt_seconds", "usockets_tcp_cwnd_segments", "usockets_tcp_retransmits", "usockets_tcp_unacked_bytes"
+};
+
+static const char *tcp_info_help[LIBUS_TCP_INFO_TYPES] = {
+    "Smoothed round trip time of sampled connections.",
+    "Congestion window of sampled connections.",
+    "Segments retransmitted over the life of sampled connections.",
+    "Bytes sent and not acknowledged yet on sampled connections."
+};
+
+static void us_internal_exporter_printf(struct us_internal_exporter_text_t *text, const char *format, ...) {
+    va_list args;
+    while (text->data) {
+        va_start(args, format);
+        int length = vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+        va_end(args);
+        if (length < 0) {
+            return;
+        }
+        if (text->length + length < text->capacity) {
+            text->length += length;
+            return;
+        }
+
+        /* Did not fit, grow and print again */
+        char *data = realloc(text->data, text->capacity * 2 + length);
+        if (!data) {
+            free(text->data);
+            text->data = 0;
+            return;
+        }
+        text->data = data;
+        text->capacity = text->capacity * 2 + length;
+    }
+}
+
+static void us_internal_exporter_metric(struct us_internal_exporter_text_t *text, const char *name, const char *type,
+    const char *help, unsigned long long value) {
+    us_internal_exporter_printf(text, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, value);
+}
+
+static void us_internal_exporter_seconds(struct us_internal_exporter_text_t *text, const char *name, const char *type,
+    const char *help, unsigned long long ns) {
+    us_internal_exporter_printf(text, "# HELP %s %s\n# TYPE %s %s\n%s %llu.%09llu\n", name, help, name, type, name,
+        ns / 1000000000, ns % 1000000000);
+}
+
+/* Label values may hold anything but backslash, quote and newline unescaped */
+static void us_internal_exporter_label(struct us_internal_exporter_text_t *text, const char *value) {
+    for (; *value; value++) {
+        if (*value == '\\' || *value == '"') {
+            us_internal_exporter_printf(text, "\\%c", *value);
+        } else if (*value == '\n') {
+            us_internal_exporter_printf(text, "\\n");
+        } else {
+            us_internal_exporter_printf(text, "%c", *value);
+        }
+    }
+}
+
+/* Opens a series of a histogram, labelled with the context and, for callbacks, the callback */
+static void us_internal_exporter_series(struct us_internal_exporter_text_t *text, const char *name, const char *suffix,
+    const char *context, const char *callback) {
+    us_internal_exporter_printf(text, "%s_%s{context=\"", name, suffix);
+    us_internal_exporter_label(text, context);
+    if (callback) {
+        us_internal_exporter_printf(text, "\",callback=\"%s\"", callback);
+    } else {
+        us_internal_exporter_printf(text, "\"");
+    }
+}
+
+/* Buckets at every power of two, cumulative as Prometheus wants them. Values are whole numbers, so what is below
+ * the floor of a bucket is at most one less. Microseconds are exported as seconds */
+static void us_internal_exporter_histogram(struct us_internal_exporter_text_t *text, const char *name, const char *context,
+    const char *callback, int microseconds, struct us_histogram_t *histogram) {
+    unsigned long long cumulative = 0;
+    int next = 0;
+    for (int bucket = 1; bucket < LIBUS_HISTOGRAM_BUCKETS; bucket = bucket < 4 ? bucket * 2 : bucket + 4) {
+        while (next < bucket) {
+            cumulative += histogram->buckets[next++];
+        }
+        unsigned int le = us_histogram_bucket_floor(bucket) - 1;
+        us_internal_exporter_series(text, name, "bucket", context, callback);
+        if (microseconds) {
+            us_internal_exporter_printf(text, ",le=\"%u.%06u\"} %llu\n", le / 1000000, le % 1000000, cumulative);
+        } else {
+            us_internal_exporter_printf(text, ",le=\"%u\"} %llu\n", le, cumulative);
+        }
+    }
+
+    /* Counted from the buckets, as count is read apart from them and may lag behind */
+    while (next < LIBUS_HISTOGRAM_BUCKETS) {
+        cumulative += histogram->buckets[next++];
+    }
+    us_internal_exporter_series(text, name, "bucket", context, callback);
+    us_internal_exporter_printf(text, ",le=\"+Inf\"} %llu\n", cumulative);
+
+    us_internal_exporter_series(text, name, "sum", context, callback);
+    if (microseconds) {
+        us_internal_exporter_printf(text, "} %llu.%06llu\n", histogram->total / 1000000, histogram->total % 1000000);
+    } else {
+        us_internal_exporter_printf(text, "} %llu\n", histogram->total);
+    }
+    us_internal_exporter_series(text, name, "count", context, callback);
+    us_internal_exporter_printf(text, "} %llu\n", cumulative);
+}
+
+static void us_internal_exporter_render(struct us_metrics_exporter_t *exporter, struct us_internal_exporter_text_t *text) {
+    /* Summed over loops, but the longest sweep is the longest of any */
+    struct us_loop_stats_t total = {0}, stats;
+    for (int i = 0; i < exporter->num_loops; i++) {
+        us_loop_stats(exporter->loops[i], &stats);
+        unsigned long long *from = (unsigned long long *) &stats, *to = (unsigned long long *) &total;
+        for (size_t j = 0; j < sizeof(struct us_loop_stats_t) / sizeof(unsigned long long); j++) {
+            to[j] += from[j];
+        }
+        total.sweep_max_ns -= stats.sweep_max_ns;
+        if (stats.sweep_max_ns > total.sweep_max_ns) {
+            total.sweep_max_ns = stats.sweep_max_ns;
+        }
+    }
+
+    us_internal_exporter_metric(text, "usockets_loops", "gauge", "Loops exported.", exporter->num_loops);
+    us_internal_exporter_metric(text, "usockets_loop_iterations_total", "counter", "Loop iterations.", total.iterations);
+    us_internal_exporter_printf(text, "# HELP usockets_events_total Ready polls dispatched, by poll type.\n"
+        "# TYPE usockets_events_total counter\n"
+        "usockets_events_total{type=\"socket\"} %llu\n"
+        "usockets_events_total{type=\"semi_socket\"} %llu\n"
+        "usockets_events_total{type=\"callback\"} %llu\n",
+        total.socket_events, total.semi_socket_events, total.callback_events);
+    us_internal_exporter_seconds(text, "usockets_loop_wait_seconds_total", "counter", "Time blocked waiting for events.", total.wait_ns);
+    us_internal_exporter_seconds(text, "usockets_loop_busy_seconds_total", "counter", "Time spent in loop iterations besides waiting.", total.dispatch_ns);
+    us_internal_exporter_metric(text, "usockets_receive_calls_total", "counter", "Reads from sockets.", total.recv_calls);
+    us_internal_exporter_metric(text, "usockets_received_bytes_total", "counter", "Bytes read from sockets.", total.recv_bytes);
+    us_internal_exporter_metric(text, "usockets_send_calls_total", "counter", "Writes to sockets.", total.send_calls);
+    us_internal_exporter_metric(text, "usockets_sent_bytes_total", "counter", "Bytes written to sockets.", total.send_bytes);
+    us_internal_exporter_metric(text, "usockets_partial_writes_total", "counter", "Writes the kernel took only part of.", total.partial_writes);
+    us_internal_exporter_metric(text, "usockets_accepts_total", "counter", "Connections accepted.", total.accepts);
+    us_internal_exporter_metric(text, "usockets_closes_total", "counter", "Sockets closed.", total.closes);
+    us_internal_exporter_metric(text, "usockets_sockets", "gauge", "Sockets open, connecting ones included.", total.sockets);
+    us_internal_exporter_metric(text, "usockets_low_priority_queued", "gauge", "Sockets waiting in low-priority queues.", total.low_prio_queued);
+    us_internal_exporter_metric(text, "usockets_low_priority_deferrals_total", "counter", "Sockets put in low-priority queues.", total.low_prio_deferrals);
+    us_internal_exporter_metric(text, "usockets_sweeps_total", "counter", "Timeout sweeps.", total.sweeps);
+    us_internal_exporter_seconds(text, "usockets_sweep_seconds_total", "counter", "Time spent in timeout sweeps.", total.sweep_ns);
+    us_internal_exporter_seconds(text, "usockets_sweep_max_seconds", "gauge", "Longest timeout sweep.", total.sweep_max_ns);
+
+    /* Admission control of contexts */
+    if (exporter->num_contexts) {
+        us_internal_exporter_printf(text, "# HELP usockets_rejected_connections_total Connections turned away over limits.\n"
+            "# TYPE usockets_rejected_connections_total counter\n");
+    }
+    for (int i = 0; i < exporter->num_contexts; i++) {
+        for (int reason = 0; reason < LIBUS_REJECT_TYPES; reason++) {
+            us_internal_exporter_printf(text, "usockets_rejected_connections_total{context=\"");
+            us_internal_exporter_label(text, exporter->contexts[i].name);
+            us_internal_exporter_printf(text, "\",reason=\"%s\"} %llu\n", reject_names[reason],
+                us_socket_context_rejected(0, exporter->contexts[i].context, reason));
+        }
+    }
+
+    /* Histograms of whatever was recorded, nothing without LIBUS_USE_CALLBACK_TIMING */
+    int header = 0;
+    struct us_histogram_t histogram;
+    for (int i = 0; i < exporter->num_contexts; i++) {
+        for (int type = 0; type < LIBUS_CALLBACK_TYPES; type++) {
+            if (!us_socket_context_callback_histogram(0, exporter->contexts[i].context, type, &histogram)) {
+                continue;
+            }
+            if (!header) {
+                us_internal_exporter_printf(text, "# HELP usockets_callback_duration_seconds Time spent in callbacks.\n"
+                    "# TYPE usockets_callback_duration_seconds histogram\n");
+                header = 1;
+            }
+            us_internal_exporter_histogram(text, "usockets_callback_duration_seconds", exporter->contexts[i].name,
+                callback_names[type], 1, &histogram);
+        }
+    }
+
+    /* And of contexts sampling TCP_INFO */
+    for (int type = 0; type < LIBUS_TCP_INFO_TYPES; type++) {
+        header = 0;
+        for (int i = 0; i < exporter->num_contexts; i++) {
+            if (!us_socket_context_tcp_info_histogram(0, exporter->contexts[i].context, type, &histogram)) {
+                continue;
+            }
+            if (!header) {
+                us_internal_exporter_printf(text, "# HELP %s %s\n# TYPE %s histogram\n", tcp_info_names[type],
+                    tcp_info_help[type], tcp_info_names[type]);
+                header = 1;
+            }
+            us_internal_exporter_histogram(text, tcp_info_names[type], exporter->contexts[i].name, 0,
+                type == LIBUS_TCP_INFO_RTT_US, &histogram);
+        }
+    }
+}
+
+static struct us_socket_t *us_internal_exporter_write(struct us_socket_t *s) {
+    struct us_internal_exporter_socket_t *es = (struct us_internal_exporter_socket_t *) us_socket_ext(0, s);
+    es->offset += us_socket_write(0, s, es->response + es->offset, es->length - es->offset, 0);
+    if (es->offset == es->length) {
+        free(es->response);
+        es->response = 0;
+    }
+    return s;
+}
+
+static struct us_socket_t *us_internal_exporter_on_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+    struct us_internal_exporter_socket_t *es = (struct us_internal_exporter_socket_t *) us_socket_ext(0, s);
+    es->response = 0;
+    us_socket_timeout(0, s, EXPORTER_TIMEOUT);
+    return s;
+}
+
+/* Every data event starting with a GET is taken as a whole request, as scrapers send them in one go */
+static struct us_socket_t *us_internal_exporter_on_data(struct us_socket_t *s, char *data, int length) {
+    struct us_internal_exporter_socket_t *es = (struct us_internal_exporter_socket_t *) us_socket_ext(0, s);
+    if (length < 4 || memcmp(data, "GET ", 4)) {
+        return s;
+    }
+    if (es->response) {
+        /* Pipelining ahead of a response still being written is not supported */
+        return us_socket_close(0, s, 0, NULL);
+    }
+    us_socket_timeout(0, s, EXPORTER_TIMEOUT);
+
+    static const char not_found[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    if (length < 13 || memcmp(data + 4, "/metrics", 8) || (data[12] != ' ' && data[12] != '?')) {
+        us_socket_write(0, s, not_found, sizeof(not_found) - 1, 0);
+        return s;
+    }
+
+    struct us_metrics_exporter_t *exporter = *(struct us_metrics_exporter_t **) us_socket_context_ext(0, us_socket_context(0, s));
+    struct us_internal_exporter_text_t body = {malloc(16384), 0, 16384};
+    us_internal_exporter_render(exporter, &body);
+    if (!body.data) {
+        return us_socket_close(0, s, 0, NULL);
+    }
+
+    struct us_internal_exporter_text_t response = {malloc(body.length + 128), 0, body.length + 128};
+    us_internal_exporter_printf(&response, "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\n\r\n", body.length);
+    if (response.data) {
+        memcpy(response.data + response.length, body.data, body.length);
+    }
+    free(body.data);
+    if (!response.data) {
+        return us_socket_close(0, s, 0, NULL);
+    }
+
+    es->response = response.data;
+    es->length = response.length + body.length;
+    es->offset = 0;
+    return us_internal_exporter_write(s);
+}
+
+static struct us_socket_t *us_internal_exporter_on_writable(struct us_socket_t *s) {
+    struct us_internal_exporter_socket_t *es = (struct us_internal_exporter_socket_t *) us_socket_ext(0, s);
+    return es->response ? us_internal_exporter_write(s) : s;
+}
+
+static struct us_socket_t *us_internal_exporter_on_close(struct us_socket_t *s, int code, void *reason) {
+    struct us_internal_exporter_socket_t *es = (struct us_internal_exporter_socket_t *) us_socket_ext(0, s);
+    free(es->response);
+    es->response = 0;
+    return s;
+}
+
+static struct us_socket_t *us_internal_exporter_on_end(struct us_socket_t *s) {
+    us_socket_shutdown(0, s);
+    return us_socket_close(0, s, 0, NULL);
+}
+
+static struct us_socket_t *us_internal_exporter_on_timeout(struct us_socket_t *s) {
+    return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_metrics_exporter_t *us_create_metrics_exporter(struct us_loop_t *loop, const char *host, int port, int options) {
+    struct us_metrics_exporter_t *exporter = calloc(1, sizeof(struct us_metrics_exporter_t));
+    if (!exporter) {
+        return 0;
+    }
+
+    struct us_socket_context_options_t context_options = {0};
+    exporter->context = us_create_socket_context(0, loop, sizeof(struct us_metrics_exporter_t *), context_options);
+    if (!exporter->context) {
+        free(exporter);
+        return 0;
+    }
+    *(struct us_metrics_exporter_t **) us_socket_context_ext(0, exporter->context) = exporter;
+    us_socket_context_on_open(0, exporter->context, us_internal_exporter_on_open);
+    us_socket_context_on_data(0, exporter->context, us_internal_exporter_on_data);
+    us_socket_context_on_writable(0, exporter->context, us_internal_exporter_on_writable);
+    us_socket_context_on_close(0, exporter->context, us_internal_exporter_on_close);
+    us_socket_context_on_end(0, exporter->context, us_internal_exporter_on_end);
+    us_socket_context_on_timeout(0, exporter->context, us_internal_exporter_on_timeout);
+
+    exporter->listen_socket = us_socket_context_listen(0, exporter->context, host, port, options,
+        sizeof(struct us_internal_exporter_socket_t));
+    if (!exporter->listen_socket) {
+        us_socket_context_free(0, exporter->context);
+        free(exporter);
+        return 0;
+    }
+    return exporter;
+}
+
+int us_metrics_exporter_add_loop(struct us_metrics_exporter_t *exporter, struct us_loop_t *loop) {
+    struct us_loop_t **loops = realloc(exporter->loops, sizeof(struct us_loop_t *) * (exporter->num_loops + 1));
+    if (!loops) {
+        return 0;
+    }
+    exporter->loops = loops;
+    exporter->loops[exporter->num_loops++] = loop;
+    return 1;
+}
+
+int us_metrics_exporter_add_context(struct us_metrics_exporter_t *exporter, int ssl, struct us_socket_context_t *context, const char *name) {
+    struct us_internal_exporter_context_t *contexts = realloc(exporter->contexts,
+        sizeof(struct us_internal_exporter_context_t) * (exporter->num_contexts + 1));
+    if (!contexts) {
+        return 0;
+    }
+    exporter->contexts = contexts;
+
+    char *copy = malloc(strlen(name) + 1);
+    if (!copy) {
+        return 0;
+    }
+    strcpy(copy, name);
+    exporter->contexts[exporter->num_contexts].context = context;
+    exporter->contexts[exporter->num_contexts].name = copy;
+    exporter->num_contexts++;
+    return 1;
+}
+
+struct us_listen_socket_t *us_metrics_exporter_listen_socket(struct us_metrics_exporter_t *exporter) {
+    return exporter->listen_socket;
+}
+
+void us_metrics_exporter_close(struct us_metrics_exporter_t *exporter) {
+    us_socket_context_close(0, exporter->context);
+}
+
+void us_metrics_exporter_free(struct us_metrics_exporter_t *exporter) {
+    us_socket_context_free(0, exporter->context);
+    for (int i = 0; i < exporter->num_contexts; i++) {
+        free(exporter->contexts[i].name);
+    }
+    free(exporter->contexts);
+    free(exporter->loops);
+    free(exporter);
+}
+
+#endif
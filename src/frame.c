@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Frames are cut straight out of whatever on_data hands us. Only a frame cut off by the end of a read is
+ * copied into a buffer of the socket, and for plain sockets its remainder is then read directly into that
+ * buffer (us_socket_set_read_buffer), so it is copied at most once either way. */
+
+#define FRAME_POOL_BUFFER_SIZE 16384
+#define FRAME_POOL_MAX_LENGTH 64
+#define FRAME_DEFAULT_MAX_PAYLOAD_LENGTH (16 * 1024 * 1024)
+
+struct us_internal_frame_context_t {
+    struct us_frame_options_t options;
+    int ssl;
+    struct us_socket_t *(*on_message)(struct us_socket_t *s, char *header, int header_length, char *payload, int length);
+};
+
+/* Pooled buffers have a fixed size, larger frames get a buffer of their own which is freed right away */
+static char *us_internal_frame_buffer_get(struct us_loop_t *loop, unsigned int length, unsigned int *capacity) {
+    if (length > FRAME_POOL_BUFFER_SIZE) {
+        *capacity = length;
+        return malloc(length);
+    }
+
+    *capacity = FRAME_POOL_BUFFER_SIZE;
+    if (loop->data.frame_pool) {
+        char *buffer = loop->data.frame_pool;
+        memcpy(&loop->data.frame_pool, buffer, sizeof(void *));
+        loop->data.frame_pool_length--;
+        return buffer;
+    }
+    return malloc(FRAME_POOL_BUFFER_SIZE);
+}
+
+void us_internal_frame_buffer_release(struct us_loop_t *loop, char *buffer, unsigned int capacity) {
+    if (capacity != FRAME_POOL_BUFFER_SIZE || loop->data.frame_pool_length == FRAME_POOL_MAX_LENGTH) {
+        free(buffer);
+        return;
+    }
+
+    memcpy(buffer, &loop->data.frame_pool, sizeof(void *));
+    loop->data.frame_pool = buffer;
+    loop->data.frame_pool_length++;
+}
+
+void us_internal_frame_pool_free(struct us_loop_t *loop) {
+    while (loop->data.frame_pool) {
+        char *buffer = loop->data.frame_pool;
+        memcpy(&loop->data.frame_pool, buffer, sizeof(void *));
+        free(buffer);
+    }
+    loop->data.frame_pool_length = 0;
+}
+
+/* Returns 1 with the header and payload lengths if the header is complete, 0 if more is needed, -1 if invalid */
+static int us_internal_frame_parse_header(struct us_frame_options_t *options, const unsigned char *data, unsigned int length,
+    unsigned int *header_length, unsigned int *payload_length) {
+    unsigned int offset = (unsigned int) options->length_offset;
+    if (length <= offset) {
+        return 0;
+    }
+    data += offset;
+    length -= offset;
+
+    switch (options->length_format) {
+    case LIBUS_FRAME_LENGTH_U16:
+        if (length < 2) {
+            return 0;
+        }
+        *payload_length = options->little_endian ? (data[0] | (data[1] << 8)) : ((data[0] << 8) | data[1]);
+        *header_length = offset + 2;
+        return 1;
+    case LIBUS_FRAME_LENGTH_U32:
+        if (length < 4) {
+            return 0;
+        }
+        if (options->little_endian) {
+            *payload_length = data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int) data[3] << 24);
+        } else {
+            *payload_length = ((unsigned int) data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+        }
+        *header_length = offset + 4;
+        return 1;
+    case LIBUS_FRAME_LENGTH_VARINT:
+        *payload_length = 0;
+        for (unsigned int i = 0; i < 5; i++) {
+            if (i == length) {
+                return 0;
+            }
+            *payload_length |= (unsigned int) (data[i] & 0x7f) << (7 * i);
+            if (!(data[i] & 0x80)) {
+                *header_length = offset + i + 1;
+                return 1;
+            }
+        }
+        return -1;
+    }
+    return -1;
+}
+
+/* Takes the pooled buffer back from a socket that has no partial frame left */
+static void us_internal_frame_reset(struct us_internal_frame_context_t *framing, struct us_socket_t *s) {
+    struct us_internal_socket_aux_t *aux = s->aux;
+    us_internal_frame_buffer_release(s->context->loop, aux->frame_buffer, aux->frame_buffer_capacity);
+    aux->frame_buffer = 0;
+    aux->frame_buffer_capacity = 0;
+    aux->frame_buffered = 0;
+    aux->frame_header_length = 0;
+    aux->frame_length = 0;
+
+    if (!framing->ssl) {
+        us_socket_set_read_buffer(0, s, 0, 0);
+    }
+}
+
+/* Makes room for length bytes of frame in the buffer of the socket, returns 0 on failure */
+static int us_internal_frame_reserve(struct us_socket_t *s, unsigned int length) {
+    struct us_internal_socket_aux_t *aux = s->aux;
+    if (length <= aux->frame_buffer_capacity) {
+        return 1;
+    }
+
+    unsigned int capacity;
+    char *buffer = us_internal_frame_buffer_get(s->context->loop, length, &capacity);
+    if (!buffer) {
+        return 0;
+    }
+    if (aux->frame_buffer) {
+        memcpy(buffer, aux->frame_buffer, aux->frame_buffered);
+        us_internal_frame_buffer_release(s->context->loop, aux->frame_buffer, aux->frame_buffer_capacity);
+    }
+    aux->frame_buffer = buffer;
+    aux->frame_buffer_capacity = capacity;
+    return 1;
+}
+
+static int us_internal_frame_header_max_length(struct us_frame_options_t *options) {
+    return options->length_offset + (options->length_format == LIBUS_FRAME_LENGTH_U16 ? 2 : options->length_format == LIBUS_FRAME_LENGTH_U32 ? 4 : 5);
+}
+
+/* Continues the frame held by the socket with data. Returns how much of data was used, or -1 if the socket got closed */
+static int us_internal_frame_continue(struct us_internal_frame_context_t *framing, struct us_socket_t **sp, char *data, unsigned int length) {
+    struct us_socket_t *s = *sp;
+    struct us_internal_socket_aux_t *aux = s->aux;
+    unsigned int used = 0;
+
+    if (!aux->frame_header_length) {
+        /* Complete the header byte by byte, we cannot know how long it is beforehand */
+        unsigned int header_max_length = us_internal_frame_header_max_length(&framing->options);
+        while (!aux->frame_header_length && used < length && aux->frame_buffered < header_max_length) {
+            aux->frame_buffer[aux->frame_buffered++] = data[used++];
+
+            unsigned int payload_length;
+            int status = us_internal_frame_parse_header(&framing->options, (unsigned char *) aux->frame_buffer, aux->frame_buffered,
+                &aux->frame_header_length, &payload_length);
+            if (status == -1 || (status == 1 && payload_length > framing->options.max_payload_length)) {
+                *sp = us_socket_close(framing->ssl, s, 0, NULL);
+                return -1;
+            }
+            if (status == 1) {
+                aux->frame_length = aux->frame_header_length + payload_length;
+                if (!us_internal_frame_reserve(s, aux->frame_length)) {
+                    *sp = us_socket_close(framing->ssl, s, 0, NULL);
+                    return -1;
+                }
+            }
+        }
+
+        if (!aux->frame_header_length) {
+            return used;
+        }
+    }
+
+    /* Plain sockets read the rest of the frame straight into our buffer */
+    if (data + used != aux->frame_buffer + aux->frame_buffered) {
+        unsigned int chunk = aux->frame_length - aux->frame_buffered;
+        if (chunk > length - used) {
+            chunk = length - used;
+        }
+        memcpy(aux->frame_buffer + aux->frame_buffered, data + used, chunk);
+        used += chunk;
+        aux->frame_buffered += chunk;
+    } else {
+        aux->frame_buffered += length - used;
+        used = length;
+    }
+
+    if (aux->frame_buffered < aux->frame_length) {
+        if (!framing->ssl) {
+            us_socket_set_read_buffer(0, s, aux->frame_buffer + aux->frame_buffered, aux->frame_length - aux->frame_buffered);
+        }
+        return used;
+    }
+
+    /* The buffer stays with the socket during on_message so it cannot be handed out again */
+    char *frame = aux->frame_buffer;
+    unsigned int header_length = aux->frame_header_length;
+    unsigned int frame_length = aux->frame_length;
+    s = framing->on_message(s, frame, header_length, frame + header_length, frame_length - header_length);
+    *sp = s;
+    if (us_socket_is_closed(framing->ssl, s)) {
+        return -1;
+    }
+
+    us_internal_frame_reset(framing, s);
+    return used;
+}
+
+static struct us_socket_t *us_internal_frame_on_data(struct us_socket_t *s, char *data, int length) {
+    struct us_internal_frame_context_t *framing = s->context->framing;
+
+    if (s->aux && s->aux->frame_buffer) {
+        int used = us_internal_frame_continue(framing, &s, data, length);
+        if (used == -1) {
+            return s;
+        }
+        data += used;
+        length -= used;
+    }
+
+    while (length) {
+        unsigned int header_length, payload_length;
+        int status = us_internal_frame_parse_header(&framing->options, (unsigned char *) data, length, &header_length, &payload_length);
+        if (status == -1 || (status == 1 && payload_length > framing->options.max_payload_length)) {
+            return us_socket_close(framing->ssl, s, 0, NULL);
+        }
+
+        /* Whole frames are emitted without copying */
+        if (status == 1 && header_length + payload_length <= (unsigned int) length) {
+            s = framing->on_message(s, data, header_length, data + header_length, payload_length);
+            if (us_socket_is_closed(framing->ssl, s)) {
+                return s;
+            }
+            data += header_length + payload_length;
+            length -= header_length + payload_length;
+            continue;
+        }
+
+        /* The tail is the start of a frame continuing in later reads */
+        struct us_internal_socket_aux_t *aux = us_internal_socket_aux(s);
+        if (!aux || !us_internal_frame_reserve(s, status == 1 ? header_length + payload_length : (unsigned int) us_internal_frame_header_max_length(&framing->options))) {
+            return us_socket_close(framing->ssl, s, 0, NULL);
+        }
+        if (status == 1) {
+            aux->frame_header_length = header_length;
+            aux->frame_length = header_length + payload_length;
+        }
+        if (us_internal_frame_continue(framing, &s, data, length) == -1) {
+            return s;
+        }
+        break;
+    }
+
+    return s;
+}
+
+void us_socket_context_frame(int ssl, struct us_socket_context_t *context, struct us_frame_options_t options,
+    struct us_socket_t *(*on_message)(struct us_socket_t *s, char *header, int header_length, char *payload, int length)) {
+    if (!context->framing) {
+        context->framing = malloc(sizeof(struct us_internal_frame_context_t));
+    }
+
+    if (!options.max_payload_length) {
+        options.max_payload_length = FRAME_DEFAULT_MAX_PAYLOAD_LENGTH;
+    }
+    /* Whole frames must fit the int lengths of on_message, and header plus payload must not wrap */
+    unsigned int max_frame_payload_length = INT_MAX - us_internal_frame_header_max_length(&options);
+    if (options.max_payload_length > max_frame_payload_length) {
+        options.max_payload_length = max_frame_payload_length;
+    }
+    context->framing->options = options;
+    context->framing->ssl = ssl;
+    context->framing->on_message = on_message;
+
+    /* For SSL this sets the plaintext handler, the SSL context begins with the plain one holding our state */
+    us_socket_context_on_data(ssl, context, us_internal_frame_on_data);
+}
+
+#endif
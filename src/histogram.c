@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+
+/* Only the loop's thread records, so relaxed stores let any thread copy the histograms without locks */
+#ifdef _MSC_VER
+#define US_HISTOGRAM_LOAD(field) (field)
+#define US_HISTOGRAM_STORE(field, value) ((field) = (value))
+#else
+#define US_HISTOGRAM_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define US_HISTOGRAM_STORE(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+#endif
+
+/* Log-linear buckets like HDR histograms at two bits of precision: the top bit of the value picks the power of two,
+ * the two bits below it one of four buckets in it. Recording is a shift and an add, no search */
+static int us_internal_histogram_bucket(unsigned int value) {
+    if (value < 4) {
+        return (int) value;
+    }
+    int msb = 31;
+    while (!(value >> msb)) {
+        msb--;
+    }
+    int bucket = 4 * (msb - 1) + (int) ((value >> (msb - 2)) & 3);
+    return bucket < LIBUS_HISTOGRAM_BUCKETS ? bucket : LIBUS_HISTOGRAM_BUCKETS - 1;
+}
+
+unsigned int us_histogram_bucket_floor(int bucket) {
+    if (bucket < 4) {
+        return bucket < 0 ? 0 : (unsigned int) bucket;
+    }
+    if (bucket >= LIBUS_HISTOGRAM_BUCKETS) {
+        bucket = LIBUS_HISTOGRAM_BUCKETS - 1;
+    }
+    return (unsigned int) (4 + (bucket & 3)) << (bucket / 4 - 1);
+}
+
+unsigned int us_histogram_percentile(struct us_histogram_t *histogram, double percentile) {
+    if (!histogram->count) {
+        return 0;
+    }
+
+    /* The bucket holding the rank, reported as its upper end but never above what was seen */
+    unsigned long long rank = (unsigned long long) (histogram->count * (percentile / 100.0));
+    unsigned long long seen = 0;
+    for (int i = 0; i < LIBUS_HISTOGRAM_BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if (seen > rank) {
+            unsigned int upper = us_histogram_bucket_floor(i + 1);
+            return upper < histogram->max ? upper : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void us_internal_histogram_record(struct us_histogram_t *histogram, unsigned int value) {
+    int bucket = us_internal_histogram_bucket(value);
+    US_HISTOGRAM_STORE(histogram->count, histogram->count + 1);
+    US_HISTOGRAM_STORE(histogram->total, histogram->total + value);
+    if (value > histogram->max) {
+        US_HISTOGRAM_STORE(histogram->max, value);
+    }
+    US_HISTOGRAM_STORE(histogram->buckets[bucket], histogram->buckets[bucket] + 1);
+}
+
+/* Field by field, a recording meanwhile may leave the copy a sample or so apart */
+void us_internal_histogram_copy(struct us_histogram_t *to, struct us_histogram_t *from) {
+    to->count = US_HISTOGRAM_LOAD(from->count);
+    to->total = US_HISTOGRAM_LOAD(from->total);
+    to->max = US_HISTOGRAM_LOAD(from->max);
+    for (int i = 0; i < LIBUS_HISTOGRAM_BUCKETS; i++) {
+        to->buckets[i] = US_HISTOGRAM_LOAD(from->buckets[i]);
+    }
+}
+
+#endif
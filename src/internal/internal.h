@@ -47,6 +47,87 @@
 #include "internal/eventing/asio.h"
 #endif
 
+/* Host names are resolved on threads where we have them and a connecting poll can start late */
+#if (defined(LIBUS_USE_EPOLL) || defined(LIBUS_USE_KQUEUE)) && !defined(LIBUS_NO_ASYNC_DNS)
+#define LIBUS_USE_ASYNC_DNS
+#endif
+
+/* Connects to host names with several addresses race them (Happy Eyeballs) where polls can move to another descriptor */
+#if defined(LIBUS_USE_EPOLL) || defined(LIBUS_USE_KQUEUE)
+#define LIBUS_USE_HAPPY_EYEBALLS
+#endif
+
+/* Monotonic clock in nanoseconds */
+long long us_internal_now_ns();
+
+/* Loop metrics (us_loop_stats). Only the loop's thread writes them, so a relaxed store is enough for readers on
+ * other threads. Without LIBUS_USE_METRICS these expand to nothing, arguments included */
+#ifdef LIBUS_USE_METRICS
+#ifdef _MSC_VER
+#define US_METRIC_SET(loop, field, value) (*(volatile unsigned long long *) &(loop)->data.stats.field = (value))
+#else
+#define US_METRIC_SET(loop, field, value) __atomic_store_n(&(loop)->data.stats.field, (value), __ATOMIC_RELAXED)
+#endif
+#define US_METRIC_ADD(loop, field, value) US_METRIC_SET(loop, field, (loop)->data.stats.field + (value))
+#define US_METRIC_MAX(loop, field, value) do { if ((unsigned long long) (value) > (loop)->data.stats.field) US_METRIC_SET(loop, field, value); } while (0)
+#define US_METRIC_CLOCK(name) long long name = us_internal_now_ns()
+#else
+#define US_METRIC_SET(loop, field, value)
+#define US_METRIC_ADD(loop, field, value)
+#define US_METRIC_MAX(loop, field, value)
+#define US_METRIC_CLOCK(name)
+#endif
+
+/* Histograms (us_histogram_t) are recorded by the loop's thread and copied by any */
+void us_internal_histogram_record(struct us_histogram_t *histogram, unsigned int value);
+void us_internal_histogram_copy(struct us_histogram_t *to, struct us_histogram_t *from);
+
+/* Publishes what the loop's thread allocates lazily to other threads reading it */
+#ifdef _MSC_VER
+#define US_PUBLISH(field, value) ((field) = (value))
+#define US_ACQUIRE(field) (field)
+#else
+#define US_PUBLISH(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+#define US_ACQUIRE(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#endif
+
+/* Counters only the loop's thread adds to, read from any */
+#ifdef _MSC_VER
+#define US_COUNTER_ADD(field, value) (*(volatile unsigned long long *) &(field) = (field) + (value))
+#define US_COUNTER_LOAD(field) (*(volatile unsigned long long *) &(field))
+#else
+#define US_COUNTER_ADD(field, value) __atomic_store_n(&(field), (field) + (value), __ATOMIC_RELAXED)
+#define US_COUNTER_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#endif
+
+/* USDT probes of provider usockets for bpftrace, perf and the like (misc/bpftrace). Without LIBUS_USE_USDT these
+ * expand to nothing, arguments included */
+#ifdef LIBUS_USE_USDT
+#include <sys/sdt.h>
+#define US_PROBE1(name, a) DTRACE_PROBE1(usockets, name, a)
+#define US_PROBE2(name, a, b) DTRACE_PROBE2(usockets, name, a, b)
+#define US_PROBE3(name, a, b, c) DTRACE_PROBE3(usockets, name, a, b, c)
+#else
+#define US_PROBE1(name, a)
+#define US_PROBE2(name, a, b)
+#define US_PROBE3(name, a, b, c)
+#endif
+
+/* Callback timing (us_socket_context_callback_histogram). The context is taken before the callback runs, since the
+ * socket may be closed or moved to another context by it. Without LIBUS_USE_CALLBACK_TIMING these expand to nothing */
+#ifdef LIBUS_USE_CALLBACK_TIMING
+struct us_internal_callback_clock_t {
+    long long started_ns;
+    struct us_socket_context_t *context;
+};
+#define US_CALLBACK_BEGIN(name, ctx) struct us_internal_callback_clock_t name = {us_internal_now_ns(), (ctx)}
+#define US_CALLBACK_END(name, type) us_internal_callback_record(name.context, type, name.started_ns)
+void us_internal_callback_record(struct us_socket_context_t *context, int type, long long started_ns);
+#else
+#define US_CALLBACK_BEGIN(name, ctx)
+#define US_CALLBACK_END(name, type)
+#endif
+
 /* Poll type and what it polls for */
 enum {
     /* Two first bits */
@@ -60,6 +141,24 @@ enum {
     POLL_TYPE_POLLING_IN = 8
 };
 
+/* Socket flags */
+enum {
+    /* The app paused reading (us_socket_pause) */
+    SOCKET_FLAG_PAUSED = 1,
+    /* We got FIN, there is nothing more to read */
+    SOCKET_FLAG_RECEIVED_FIN = 2,
+    /* Used up its read quota with more data pending */
+    SOCKET_FLAG_READ_DEFERRED = 4,
+    /* Connecting socket waiting for its host name to resolve, it has no descriptor yet */
+    SOCKET_FLAG_RESOLVING = 8,
+    /* Released to the connection pool, waiting to be acquired again */
+    SOCKET_FLAG_POOL_IDLE = 16,
+    /* Counted against its source address by the IP limiter, as source */
+    SOCKET_FLAG_IP_COUNTED = 32,
+    /* Listen socket accepting on a descriptor other loops accept on too (us_socket_context_share_listen_socket) */
+    SOCKET_FLAG_SHARED_LISTEN = 64
+};
+
 /* Loop related */
 void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events);
 void us_internal_timer_sweep(struct us_loop_t *loop);
@@ -72,6 +171,11 @@ void us_internal_loop_data_free(struct us_loop_t *loop);
 void us_internal_loop_pre(struct us_loop_t *loop);
 void us_internal_loop_post(struct us_loop_t *loop);
 
+/* Lag monitor (lag.c), backends call ready as polling returns */
+struct us_internal_lag_monitor_t;
+void us_internal_lag_ready(struct us_loop_t *loop);
+void us_internal_lag_end(struct us_loop_t *loop);
+
 /* Asyncs (old) */
 struct us_internal_async *us_internal_create_async(struct us_loop_t *loop, int fallthrough, unsigned int ext_size);
 void us_internal_async_close(struct us_internal_async *a);
@@ -86,21 +190,116 @@ void us_internal_poll_set_type(struct us_poll_t *p, int poll_type);
 /* SSL loop data */
 void us_internal_init_loop_ssl_data(struct us_loop_t *loop);
 void us_internal_free_loop_ssl_data(struct us_loop_t *loop);
+void us_internal_ssl_replay_held(struct us_loop_t *loop);
 
 /* Socket context related */
 void us_internal_socket_context_link_socket(struct us_socket_context_t *context, struct us_socket_t *s);
 void us_internal_socket_context_unlink_socket(struct us_socket_context_t *context, struct us_socket_t *s);
 
+/* Rarely used per-socket state lives out of line so that plain sockets stay small */
+struct us_internal_socket_aux_t {
+    /* Splice pipe carrying data read from this socket towards pipe_peer (us_socket_pipe) */
+    struct us_socket_t *pipe_peer;
+    LIBUS_SOCKET_DESCRIPTOR pipe_fds[2];
+    int pipe_buffered;
+
+    /* Application buffer reads go straight into instead of the shared recv buffer (us_socket_set_read_buffer) */
+    char *read_buffer;
+    int read_buffer_length;
+
+    /* Frame straddling reads, header_length is 0 until its header is complete (us_socket_context_frame) */
+    char *frame_buffer;
+    unsigned int frame_buffer_capacity;
+    unsigned int frame_buffered;
+    unsigned int frame_header_length;
+    unsigned int frame_length;
+
+    /* Pending host name resolution of a connecting socket (dns.c) */
+    struct us_internal_resolve_request_t *resolve_request;
+
+    /* Attempts of a connecting socket racing the addresses of its host name (context.c) */
+    struct us_internal_connect_race_t *connect_race;
+
+    /* Connection pool the socket counts against and, while idle, its neighbours there (pool.c) */
+    struct us_internal_pool_host_t *pool_host;
+    struct us_socket_t *pool_prev, *pool_next;
+    int pool_ext_size;
+};
+
 /* Sockets are polls */
 struct us_socket_t {
     alignas(LIBUS_EXT_ALIGNMENT) struct us_poll_t p; // 4 bytes
     unsigned char timeout; // 1 byte
     unsigned char long_timeout; // 1 byte
     unsigned short low_prio_state; /* 0 = not in low-prio queue, 1 = is in low-prio queue, 2 = was in low-prio queue in this iteration */
+    unsigned char flags; /* SOCKET_FLAG_* */
+    unsigned char read_shift; /* Next read asks for MIN_ADAPTIVE_READ_LENGTH << read_shift bytes when adaptive */
     struct us_socket_context_t *context;
     struct us_socket_t *prev, *next;
+    struct us_internal_socket_aux_t *aux; /* Null until some rarely used feature needs it */
+    unsigned int source; /* Hash of the source address, with SOCKET_FLAG_IP_COUNTED (ip_limit.c) */
 };
 
+/* Returns the aux state of this socket, allocating it on first use */
+struct us_internal_socket_aux_t *us_internal_socket_aux(struct us_socket_t *s);
+
+/* Splice piping (pipe.c) */
+struct us_socket_t *us_internal_socket_pipe_dispatch(struct us_socket_t *s, int events);
+void us_internal_socket_pipe_close(struct us_socket_t *s);
+struct us_socket_t *us_internal_socket_pipe_hangup(struct us_socket_t *s);
+
+/* Framing (frame.c) */
+struct us_internal_frame_context_t;
+void us_internal_frame_buffer_release(struct us_loop_t *loop, char *buffer, unsigned int capacity);
+void us_internal_frame_pool_free(struct us_loop_t *loop);
+
+/* Asynchronous host name resolution (dns.c) */
+int us_internal_socket_resolve(struct us_socket_t *s, const char *host, int port, const char *source_host, int options);
+void us_internal_socket_resolve_cancel(struct us_socket_t *s);
+void us_internal_socket_resolve_adopt(struct us_socket_t *s);
+void us_internal_resolver_free(struct us_loop_t *loop);
+void us_internal_dns_cache_free(struct us_loop_t *loop);
+
+/* Per source address limits of accepting (ip_limit.c). Admitting counts the connection against its source,
+ * returned as source_hash, or not at all for sources not tracked. Rejecting counts the rejection in context */
+struct us_internal_ip_limiter_t;
+int us_internal_ip_limiter_admit(struct us_socket_context_t *context, char *ip, int ip_length, unsigned int *source_hash);
+void us_internal_ip_limiter_release(struct us_loop_t *loop, unsigned int source_hash);
+void us_internal_ip_limiter_free(struct us_loop_t *loop);
+
+/* Adopts what the accept loop accepted, counted against source unless 0 */
+struct us_socket_t *us_internal_adopt_accepted_socket(struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR accepted_fd,
+    unsigned int socket_ext_size, char *addr_ip, int addr_ip_length, unsigned int source);
+int us_internal_socket_connect(struct us_socket_t *s, const char *host, int port, const char *source_host, int options);
+
+/* Connecting to resolved addresses (context.c) */
+struct addrinfo;
+int us_internal_socket_connect_resolved(struct us_socket_t *s, struct addrinfo *result, struct addrinfo *source_result, int options);
+struct us_socket_t *us_internal_connect_race_settle(struct us_socket_t *attempt, int *error);
+void us_internal_connect_race_cancel(struct us_socket_t *s);
+void us_internal_connect_race_adopt(struct us_socket_t *s);
+struct us_socket_t *us_internal_socket_context_connect_addr(int ssl, struct us_socket_context_t *context, struct bsd_addr_t *addr,
+    struct bsd_addr_t *source, int options, int socket_ext_size);
+
+/* Connection pool (pool.c) */
+struct us_internal_pool_t;
+void us_internal_pool_forget(struct us_socket_t *s);
+void us_internal_pool_close(struct us_socket_context_t *context);
+void us_internal_pool_free(struct us_socket_context_t *context);
+
+/* Bulk connects (bulk.c) */
+struct us_internal_bulk_connect_t;
+void us_internal_bulk_connect_cancel(struct us_socket_context_t *context);
+
+/* TCP_INFO sampling (tcp_info.c) */
+struct us_internal_tcp_sampler_t;
+void us_internal_tcp_info_sample(struct us_socket_context_t *context);
+
+/* Acceptor handing connections to worker loops (acceptor.c) */
+struct us_internal_acceptor_worker_t;
+void us_internal_acceptor_accept(struct us_acceptor_t *acceptor, LIBUS_SOCKET_DESCRIPTOR listen_fd);
+void us_internal_acceptor_worker_count(struct us_internal_acceptor_worker_t *w, int change);
+
 /* Internal callback types are polls just like sockets */
 struct us_internal_callback_t {
     alignas(LIBUS_EXT_ALIGNMENT) struct us_poll_t p;
@@ -116,6 +315,25 @@ struct us_listen_socket_t {
     unsigned int socket_ext_size;
 };
 
+/* Reasons for a context to stop accepting, as bits of shedding */
+enum {
+    SHED_SOCKETS = 1,
+    SHED_OVERLOAD = 2
+};
+
+/* Pauses or resumes the listen sockets of context as the first reason to shed load comes or the last goes */
+void us_internal_socket_context_shed(struct us_socket_context_t *context, int reason, int on);
+
+/* Counts s in or out of its context, by link and unlink but for the low-priority queue */
+void us_internal_socket_context_count(struct us_socket_context_t *context, struct us_socket_t *s, int change);
+
+/* Whether context is over a limit for one more socket, accepted or connecting. Counts the rejection if so */
+int us_internal_socket_context_reject(struct us_socket_context_t *context, int connecting);
+
+/* Whether a connection accepted on fd gets into context, closing fd if not. Sets source to what the IP limiter of
+ * the loop counted it as, 0 for nothing */
+int us_internal_socket_context_admit(struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR fd, char *ip, int ip_length, unsigned int *source);
+
 /* Listen sockets are keps in their own list */
 void us_internal_socket_context_link_listen_socket(struct us_socket_context_t *context, struct us_listen_socket_t *s);
 void us_internal_socket_context_unlink_listen_socket(struct us_socket_context_t *context, struct us_listen_socket_t *s);
@@ -141,6 +359,35 @@ struct us_socket_context_t {
     struct us_socket_t *(*on_end)(struct us_socket_t *);
     struct us_socket_t *(*on_connect_error)(struct us_socket_t *, int code);
     int (*is_low_prio)(struct us_socket_t *);
+    /* Reads use recvmsg while set (us_socket_context_on_fds) */
+    struct us_socket_t *(*on_fds)(struct us_socket_t *, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds);
+    /* Closes what is left once draining is past its deadline (us_socket_context_drain) */
+    struct us_timer_t *drain_timer;
+    struct us_internal_frame_context_t *framing;
+    struct us_internal_pool_t *pool;
+    struct us_internal_bulk_connect_t *bulk_connects;
+    /* Listen sockets of an acceptor context hand connections to workers (us_create_acceptor) */
+    struct us_acceptor_t *acceptor;
+    /* Counts the sockets of a context adopting what an acceptor hands over */
+    struct us_internal_acceptor_worker_t *acceptor_worker;
+    /* Sampling of TCP_INFO (us_socket_context_sample_tcp_info) */
+    struct us_internal_tcp_sampler_t *tcp_sampler;
+    /* Sockets of the context, connecting ones and those queued for low priority included */
+    unsigned int num_sockets;
+    unsigned int num_connecting;
+    /* SSL sockets still in their handshake, kept by the SSL layer */
+    unsigned int num_handshaking;
+    /* Admission control (us_socket_context_set_limits), counters read from any thread */
+    struct us_socket_context_limits_t limits;
+    unsigned long long rejected[LIBUS_REJECT_TYPES];
+    /* Listen sockets stop polling while any SHED_* reason holds (us_socket_context_shed_load) */
+    unsigned int shed_sockets;
+    int shed_level;
+    unsigned char shedding;
+#ifdef LIBUS_USE_CALLBACK_TIMING
+    /* One histogram per callback type, allocated by the first callback timed */
+    struct us_histogram_t *callback_timing;
+#endif
 };
 
 #endif
@@ -195,8 +442,11 @@ struct us_listen_socket_t *us_internal_ssl_socket_context_listen(struct us_inter
 struct us_listen_socket_t *us_internal_ssl_socket_context_listen_unix(struct us_internal_ssl_socket_context_t *context,
     const char *path, int options, int socket_ext_size);
 
+struct us_listen_socket_t *us_internal_ssl_socket_context_adopt_listen_socket(struct us_internal_ssl_socket_context_t *context,
+    LIBUS_SOCKET_DESCRIPTOR fd, int socket_ext_size);
+
 struct us_internal_ssl_socket_t *us_internal_ssl_adopt_accepted_socket(struct us_internal_ssl_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR accepted_fd,
-    unsigned int socket_ext_size, char *addr_ip, int addr_ip_length);
+    unsigned int socket_ext_size, char *addr_ip, int addr_ip_length, unsigned int source);
 
 struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_connect(struct us_internal_ssl_socket_context_t *context,
     const char *host, int port, const char *source_host, int options, int socket_ext_size);
@@ -205,6 +455,9 @@ struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_connect(struct u
 struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_connect_unix(struct us_internal_ssl_socket_context_t *context,
     const char *server_path, int options, int socket_ext_size);
 
+struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_connect_addr(struct us_internal_ssl_socket_context_t *context,
+    struct bsd_addr_t *addr, struct bsd_addr_t *source, int options, int socket_ext_size);
+
 int us_internal_ssl_socket_write(struct us_internal_ssl_socket_t *s, const char *data, int length, int msg_more);
 void us_internal_ssl_socket_timeout(struct us_internal_ssl_socket_t *s, unsigned int seconds);
 void *us_internal_ssl_socket_context_ext(struct us_internal_ssl_socket_context_t *s);
@@ -212,6 +465,7 @@ struct us_internal_ssl_socket_context_t *us_internal_ssl_socket_get_context(stru
 void *us_internal_ssl_socket_ext(struct us_internal_ssl_socket_t *s);
 int us_internal_ssl_socket_is_shut_down(struct us_internal_ssl_socket_t *s);
 void us_internal_ssl_socket_shutdown(struct us_internal_ssl_socket_t *s);
+void us_internal_ssl_socket_resume(struct us_internal_ssl_socket_t *s);
 
 struct us_internal_ssl_socket_t *us_internal_ssl_socket_context_adopt_socket(struct us_internal_ssl_socket_context_t *context,
     struct us_internal_ssl_socket_t *s, int ext_size);
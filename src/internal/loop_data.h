@@ -25,12 +25,44 @@ struct us_internal_loop_data_t {
     struct us_socket_context_t *head;
     struct us_socket_context_t *iterator;
     char *recv_buf;
+    int recv_buf_length;
+    /* Size reads per socket by how much it recently got (us_loop_options_t) */
+    int adaptive_read_size;
     void *ssl_data;
     void (*pre_cb)(struct us_loop_t *);
     void (*post_cb)(struct us_loop_t *);
     struct us_socket_t *closed_head;
     struct us_socket_t *low_prio_head;
     int low_prio_budget;
+    /* Sockets the low-priority queue lets through per iteration (us_loop_set_low_priority_budget) */
+    int low_prio_max;
+    /* Measures iteration lag while us_loop_on_overload is set */
+    struct us_internal_lag_monitor_t *lag_monitor;
+    /* Bytes a socket may read per iteration before others get their turn, 0 = unlimited */
+    unsigned int read_quota;
+    /* Fixed size buffers for reassembling frames, linked through their first bytes */
+    void *frame_pool;
+    int frame_pool_length;
+    /* Resolves host names of connecting sockets, created on first use */
+    struct us_internal_resolver_t *resolver;
+    /* What host names resolved to, created by us_loop_set_dns_cache */
+    struct us_internal_dns_cache_t *dns_cache;
+    /* Limits accepting per source address (us_loop_limit_ips) */
+    struct us_internal_ip_limiter_t *ip_limiter;
+    /* Hashes sources for it, kept for as long as the loop since sockets remember their source by hash */
+    unsigned int ip_limiter_seed;
+    /* Contexts of this loop adopting connections from acceptors on other threads, woken through acceptor_async */
+    struct us_internal_acceptor_worker_t *acceptor_workers;
+    struct us_internal_async *acceptor_async;
+#ifdef LIBUS_USE_METRICS
+    /* Written by the loop's thread only, read from any (us_loop_stats) */
+    struct us_loop_stats_t stats;
+#endif
+#ifdef LIBUS_USE_CALLBACK_TIMING
+    /* Reports callbacks taking slow_callback_us or longer (us_loop_on_slow_callback) */
+    unsigned int slow_callback_us;
+    void (*on_slow_callback)(struct us_socket_context_t *, int type, unsigned int elapsed_us);
+#endif
     /* We do not care if this flips or not, it doesn't matter */
     long long iteration_nr;
 };
@@ -72,6 +72,8 @@ LIBUS_SOCKET_DESCRIPTOR apple_no_sigpipe(LIBUS_SOCKET_DESCRIPTOR fd);
 LIBUS_SOCKET_DESCRIPTOR bsd_set_nonblocking(LIBUS_SOCKET_DESCRIPTOR fd);
 void bsd_socket_nodelay(LIBUS_SOCKET_DESCRIPTOR fd, int enabled);
 void bsd_socket_flush(LIBUS_SOCKET_DESCRIPTOR fd);
+void bsd_socket_reset_on_close(LIBUS_SOCKET_DESCRIPTOR fd);
+int bsd_socket_tcp_info(LIBUS_SOCKET_DESCRIPTOR fd, struct us_tcp_info_t *info);
 LIBUS_SOCKET_DESCRIPTOR bsd_create_socket(int domain, int type, int protocol);
 
 void bsd_close_socket(LIBUS_SOCKET_DESCRIPTOR fd);
@@ -96,17 +98,48 @@ int bsd_send(LIBUS_SOCKET_DESCRIPTOR fd, const char *buf, int length, int msg_mo
 int bsd_write2(LIBUS_SOCKET_DESCRIPTOR fd, const char *header, int header_length, const char *payload, int payload_length);
 int bsd_would_block();
 
+/* Descriptors passed over unix sockets (SCM_RIGHTS) go with the first byte of buf, none on Windows */
+int bsd_send_fds(LIBUS_SOCKET_DESCRIPTOR fd, const char *buf, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds);
+int bsd_recv_fds(LIBUS_SOCKET_DESCRIPTOR fd, void *buf, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int *num_fds);
+
+/* Kernel-side forwarding between two descriptors through a pipe (Linux only, fails elsewhere) */
+int bsd_create_pipe(LIBUS_SOCKET_DESCRIPTOR fds[2]);
+int bsd_splice(LIBUS_SOCKET_DESCRIPTOR fd_in, LIBUS_SOCKET_DESCRIPTOR fd_out, int length);
+int bsd_pipe_read(LIBUS_SOCKET_DESCRIPTOR fd, void *buf, int length);
+
 // return LIBUS_SOCKET_ERROR or the fd that represents listen socket
 // listen both on ipv6 and ipv4
 LIBUS_SOCKET_DESCRIPTOR bsd_create_listen_socket(const char *host, int port, int options);
 
 LIBUS_SOCKET_DESCRIPTOR bsd_create_listen_socket_unix(const char *path, int options);
 
+/* Whether fd is a socket that listen was called on */
+int bsd_is_listen_socket(LIBUS_SOCKET_DESCRIPTOR fd);
+
+/* Another descriptor of the same socket, close-on-exec, or LIBUS_SOCKET_ERROR */
+LIBUS_SOCKET_DESCRIPTOR bsd_dup_socket(LIBUS_SOCKET_DESCRIPTOR fd);
+
 /* Creates an UDP socket bound to the hostname and port */
 LIBUS_SOCKET_DESCRIPTOR bsd_create_udp_socket(const char *host, int port);
 
 LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket(const char *host, int port, const char *source_host, int options);
 
+/* The steps of bsd_create_connect_socket, so that resolving can happen off the loop thread */
+struct addrinfo;
+int bsd_is_numeric_host(const char *host);
+int bsd_resolve_connect_host(const char *host, int port, struct addrinfo **result);
+int bsd_resolve_source_host(const char *source_host, struct addrinfo **result);
+LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket_resolved(struct addrinfo *result, struct addrinfo *source_result, int options);
+void bsd_free_addrinfo(struct addrinfo *result);
+/* Whether a resolve error means the name does not exist, as opposed to a temporary failure */
+int bsd_resolve_error_is_permanent(int error);
+/* Copies at most max_length addresses of result in the order Happy Eyeballs (RFC 8305) tries them, alternating address
+ * families, and the source address if any. Addresses of another family than the source are left out. Returns how many were copied */
+int bsd_connect_addresses(struct addrinfo *result, struct addrinfo *source_result, struct bsd_addr_t *addresses, int max_length,
+    struct bsd_addr_t *source);
+/* Source of zero length means none */
+LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket_addr(struct bsd_addr_t *addr, struct bsd_addr_t *source, int options);
+
 LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket_unix(const char *server_path, int options);
 
 #endif // BSD_H
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Sources tracked by default and at most */
+static const unsigned int DEFAULT_MAX_SOURCES = 16384;
+static const unsigned int MAX_SOURCES = 1 << 24;
+
+/* Buckets count thousandths of a connection in 32 bits */
+static const unsigned int MAX_BURST = 1000000;
+
+/* Full tables are purged of idle sources at most this often */
+static const unsigned int PURGE_INTERVAL_MS = 1000;
+
+/* A source address, IPv4 as IPv4-mapped IPv6, with the bits past the prefix cleared. Sockets know their source by
+ * hash alone, so no two sources in the table share one, entries are free to move, and the seed of the hash never
+ * changes for the loop */
+struct us_internal_ip_source_t {
+    unsigned char key[16];
+    unsigned int hash; /* 0 for an empty slot */
+    unsigned int tokens; /* Thousandths of a connection */
+    unsigned int stamp_ms; /* Of the last refill */
+    unsigned int connections;
+};
+
+/* Open addressing with linear probing, at most half full */
+struct us_internal_ip_limiter_t {
+    struct us_ip_limits_t limits;
+    unsigned int mask;
+    unsigned int num_sources;
+    unsigned int purge_ms;
+    struct us_internal_ip_source_t *sources;
+};
+
+static unsigned int us_internal_ip_now_ms() {
+    return (unsigned int) (us_internal_now_ns() / 1000000);
+}
+
+/* Returns the slot holding hash, or the empty one it would go into */
+static struct us_internal_ip_source_t *us_internal_ip_find(struct us_internal_ip_limiter_t *limiter, unsigned int hash) {
+    unsigned int i = hash & limiter->mask;
+    while (limiter->sources[i].hash && limiter->sources[i].hash != hash) {
+        i = (i + 1) & limiter->mask;
+    }
+    return &limiter->sources[i];
+}
+
+static void us_internal_ip_refill(struct us_internal_ip_limiter_t *limiter, struct us_internal_ip_source_t *source, unsigned int now_ms) {
+    unsigned long long tokens = source->tokens + (unsigned long long) (now_ms - source->stamp_ms) * limiter->limits.rate;
+    unsigned long long burst = (unsigned long long) limiter->limits.burst * 1000;
+    source->tokens = (unsigned int) (tokens < burst ? tokens : burst);
+    source->stamp_ms = now_ms;
+}
+
+/* Drops sources with nothing open and a full bucket, they are no different from sources never seen */
+static void us_internal_ip_purge(struct us_internal_ip_limiter_t *limiter, unsigned int now_ms) {
+    struct us_internal_ip_source_t *sources = calloc(limiter->mask + 1, sizeof(struct us_internal_ip_source_t));
+    if (!sources) {
+        return;
+    }
+
+    struct us_internal_ip_source_t *old_sources = limiter->sources;
+    limiter->sources = sources;
+    limiter->num_sources = 0;
+    for (unsigned int i = 0; i <= limiter->mask; i++) {
+        if (!old_sources[i].hash) {
+            continue;
+        }
+        us_internal_ip_refill(limiter, &old_sources[i], now_ms);
+        if (old_sources[i].connections || old_sources[i].tokens < limiter->limits.burst * 1000) {
+            *us_internal_ip_find(limiter, old_sources[i].hash) = old_sources[i];
+            limiter->num_sources++;
+        }
+    }
+    free(old_sources);
+}
+
+int us_internal_ip_limiter_admit(struct us_socket_context_t *context, char *ip, int ip_length, unsigned int *source_hash) {
+    struct us_internal_ip_limiter_t *limiter = context->loop->data.ip_limiter;
+
+    /* Unix sockets have no address to tell sources apart by */
+    unsigned char key[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+    int prefix;
+    if (ip_length == 4) {
+        memcpy(key + 12, ip, 4);
+        prefix = 96 + limiter->limits.ipv4_prefix;
+    } else if (ip_length == 16) {
+        memcpy(key, ip, 16);
+        prefix = memcmp(key, "\0\0\0\0\0\0\0\0\0\0\xFF\xFF", 12) ? limiter->limits.ipv6_prefix : 96 + limiter->limits.ipv4_prefix;
+    } else {
+        return 1;
+    }
+    for (int i = prefix / 8; i < 16; i++) {
+        key[i] &= (i == prefix / 8) ? (unsigned char) (0xFF00 >> (prefix % 8)) : 0;
+    }
+
+    /* FNV-1a, seeded per loop */
+    unsigned int hash = 2166136261u ^ context->loop->data.ip_limiter_seed;
+    for (int i = 0; i < 16; i++) {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+    hash = hash ? hash : 1;
+
+    unsigned int now_ms = us_internal_ip_now_ms();
+    struct us_internal_ip_source_t *source = us_internal_ip_find(limiter, hash);
+    if (!source->hash) {
+        if (limiter->num_sources >= limiter->limits.max_sources && now_ms - limiter->purge_ms >= PURGE_INTERVAL_MS) {
+            limiter->purge_ms = now_ms;
+            us_internal_ip_purge(limiter, now_ms);
+            source = us_internal_ip_find(limiter, hash);
+        }
+
+        /* Sources we cannot keep track of are let through */
+        if (limiter->num_sources >= limiter->limits.max_sources) {
+            return 1;
+        }
+        memcpy(source->key, key, 16);
+        source->hash = hash;
+        source->tokens = limiter->limits.burst * 1000;
+        source->stamp_ms = now_ms;
+        source->connections = 0;
+        limiter->num_sources++;
+    } else if (memcmp(source->key, key, 16)) {
+        /* Another source with the same hash, which sockets could not tell apart */
+        return 1;
+    }
+
+    if (limiter->limits.max_connections && source->connections >= limiter->limits.max_connections) {
+        US_COUNTER_ADD(context->rejected[LIBUS_REJECT_IP_CONNECTIONS], 1);
+        return 0;
+    }
+    if (limiter->limits.rate) {
+        us_internal_ip_refill(limiter, source, now_ms);
+        if (source->tokens < 1000) {
+            US_COUNTER_ADD(context->rejected[LIBUS_REJECT_IP_RATE], 1);
+            return 0;
+        }
+        source->tokens -= 1000;
+    }
+
+    source->connections++;
+    *source_hash = hash;
+    return 1;
+}
+
+void us_internal_ip_limiter_release(struct us_loop_t *loop, unsigned int source_hash) {
+    /* Limits may have been lifted or replaced since */
+    struct us_internal_ip_limiter_t *limiter = loop->data.ip_limiter;
+    if (limiter) {
+        struct us_internal_ip_source_t *source = us_internal_ip_find(limiter, source_hash);
+        if (source->hash && source->connections) {
+            source->connections--;
+        }
+    }
+}
+
+void us_internal_ip_limiter_free(struct us_loop_t *loop) {
+    if (loop->data.ip_limiter) {
+        free(loop->data.ip_limiter->sources);
+        free(loop->data.ip_limiter);
+        loop->data.ip_limiter = 0;
+    }
+}
+
+void us_loop_limit_ips(struct us_loop_t *loop, const struct us_ip_limits_t *limits) {
+    if (!limits) {
+        us_internal_ip_limiter_free(loop);
+        return;
+    }
+
+    struct us_ip_limits_t l = *limits;
+    l.burst = l.burst ? l.burst : (l.rate ? l.rate : 1);
+    l.burst = l.burst < MAX_BURST ? l.burst : MAX_BURST;
+    l.ipv4_prefix = (l.ipv4_prefix > 0 && l.ipv4_prefix <= 32) ? l.ipv4_prefix : 32;
+    l.ipv6_prefix = (l.ipv6_prefix > 0 && l.ipv6_prefix <= 128) ? l.ipv6_prefix : 64;
+    l.max_sources = l.max_sources ? (l.max_sources < MAX_SOURCES ? l.max_sources : MAX_SOURCES) : DEFAULT_MAX_SOURCES;
+
+    /* Sources counted so far stay in place while the table keeps its size */
+    unsigned int capacity = 2;
+    while (capacity < l.max_sources * 2) {
+        capacity *= 2;
+    }
+    struct us_internal_ip_limiter_t *old_limiter = loop->data.ip_limiter;
+    if (old_limiter && old_limiter->mask + 1 == capacity) {
+        old_limiter->limits = l;
+        return;
+    }
+
+    struct us_internal_ip_limiter_t *limiter = malloc(sizeof(struct us_internal_ip_limiter_t));
+    if (!limiter) {
+        return;
+    }
+    limiter->sources = calloc(capacity, sizeof(struct us_internal_ip_source_t));
+    if (!limiter->sources) {
+        free(limiter);
+        return;
+    }
+    if (!loop->data.ip_limiter_seed) {
+        loop->data.ip_limiter_seed = ((unsigned int) us_internal_now_ns() ^ (unsigned int) (uintptr_t) loop) | 1;
+    }
+    limiter->limits = l;
+    limiter->mask = capacity - 1;
+    limiter->num_sources = 0;
+    limiter->purge_ms = us_internal_ip_now_ms() - PURGE_INTERVAL_MS;
+
+    /* Or move into the resized table, those with connections open first if not all fit */
+    if (old_limiter) {
+        for (int idle = 0; idle < 2; idle++) {
+            for (unsigned int i = 0; i <= old_limiter->mask && limiter->num_sources < l.max_sources; i++) {
+                struct us_internal_ip_source_t *source = &old_limiter->sources[i];
+                if (source->hash && (source->connections == 0) == idle) {
+                    *us_internal_ip_find(limiter, source->hash) = *source;
+                    limiter->num_sources++;
+                }
+            }
+        }
+        us_internal_ip_limiter_free(loop);
+    }
+    loop->data.ip_limiter = limiter;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* The clock is read once as polling returns and once as the iteration ends, the end of one iteration being the
+ * start of the next. Averages move an eighth of the way to each new iteration */
+struct us_internal_lag_monitor_t {
+    long long ready_ns;
+    long long end_ns;
+    long long lag_ns;
+    long long iteration_ns;
+    long long last_lag_ns;
+    unsigned int thresholds_us[2];
+    int level;
+    void (*on_overload)(struct us_loop_t *loop, int level);
+};
+
+void us_internal_lag_ready(struct us_loop_t *loop) {
+    if (loop->data.lag_monitor) {
+        loop->data.lag_monitor->ready_ns = us_internal_now_ns();
+    }
+}
+
+void us_internal_lag_end(struct us_loop_t *loop) {
+    struct us_internal_lag_monitor_t *monitor = loop->data.lag_monitor;
+    long long now = us_internal_now_ns();
+
+    /* Backends without a ready hook measure whole iterations only */
+    if (monitor->ready_ns) {
+        monitor->last_lag_ns = now - monitor->ready_ns;
+        monitor->lag_ns += (monitor->last_lag_ns - monitor->lag_ns) / 8;
+        monitor->ready_ns = 0;
+    }
+    if (monitor->end_ns) {
+        monitor->iteration_ns += (now - monitor->end_ns - monitor->iteration_ns) / 8;
+    }
+    monitor->end_ns = now;
+
+    /* Levels go up at their threshold and back down under three quarters of it, not to flap around one */
+    long long lag_us = monitor->lag_ns / 1000;
+    int level = monitor->level;
+    while (level < LIBUS_OVERLOAD_CRITICAL && lag_us >= monitor->thresholds_us[level]) {
+        level++;
+    }
+    while (level > LIBUS_OVERLOAD_NONE && lag_us < monitor->thresholds_us[level - 1] * 3LL / 4) {
+        level--;
+    }
+
+    /* Last, since the callback may stop the monitor */
+    if (level != monitor->level) {
+        monitor->level = level;
+        for (struct us_socket_context_t *context = loop->data.head; context; context = context->next) {
+            if (context->shed_level) {
+                us_internal_socket_context_shed(context, SHED_OVERLOAD, level >= context->shed_level);
+            }
+        }
+        monitor->on_overload(loop, level);
+    }
+}
+
+void us_loop_on_overload(struct us_loop_t *loop, unsigned int warning_us, unsigned int critical_us,
+    void (*on_overload)(struct us_loop_t *loop, int level)) {
+    if (!on_overload) {
+        free(loop->data.lag_monitor);
+        loop->data.lag_monitor = 0;
+        return;
+    }
+
+    if (!loop->data.lag_monitor) {
+        loop->data.lag_monitor = calloc(1, sizeof(struct us_internal_lag_monitor_t));
+        if (!loop->data.lag_monitor) {
+            return;
+        }
+    }
+    loop->data.lag_monitor->thresholds_us[0] = warning_us;
+    loop->data.lag_monitor->thresholds_us[1] = critical_us > warning_us ? critical_us : warning_us;
+    loop->data.lag_monitor->on_overload = on_overload;
+}
+
+void us_loop_lag(struct us_loop_t *loop, struct us_loop_lag_t *lag) {
+    struct us_internal_lag_monitor_t *monitor = loop->data.lag_monitor;
+    memset(lag, 0, sizeof(struct us_loop_lag_t));
+    if (monitor) {
+        lag->lag_us = (unsigned int) (monitor->lag_ns / 1000);
+        lag->iteration_us = (unsigned int) (monitor->iteration_ns / 1000);
+        lag->last_lag_us = (unsigned int) (monitor->last_lag_ns / 1000);
+        lag->level = monitor->level;
+    }
+}
+
+#endif
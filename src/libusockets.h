@@ -28,6 +28,8 @@
 #define LIBUS_RECV_BUFFER_PADDING 32
 /* Guaranteed alignment of extension memory */
 #define LIBUS_EXT_ALIGNMENT 16
+/* Most descriptors passed with one write over a unix socket */
+#define LIBUS_MAX_PASSED_FDS 16
 
 /* Define what a socket descriptor is based on platform */
 #ifdef _WIN32
@@ -48,7 +50,19 @@ enum {
     /* No meaning, default listen option */
     LIBUS_LISTEN_DEFAULT,
     /* We exclusively own this port, do not share it */
-    LIBUS_LISTEN_EXCLUSIVE_PORT
+    LIBUS_LISTEN_EXCLUSIVE_PORT,
+    /* Accept data carried by the SYN of TCP Fast Open clients */
+    LIBUS_LISTEN_FAST_OPEN
+};
+
+enum {
+    /* No meaning, default connect option */
+    LIBUS_CONNECT_DEFAULT,
+    /* TCP Fast Open where supported (Linux): on_open is emitted before the handshake and what is written
+     * from it rides on the SYN if the server supports it, else it is sent once connected. Since the SYN waits
+     * for that first write, write in on_open. Failing to connect then emits on_close, not on_connect_error.
+     * Host names resolving to several addresses are raced (Happy Eyeballs) without Fast Open instead */
+    LIBUS_CONNECT_FAST_OPEN
 };
 
 /* Library types publicly available */
@@ -185,6 +199,12 @@ void us_socket_context_on_connect_error(int ssl, struct us_socket_context_t *con
 /* Emitted when a socket has been half-closed */
 void us_socket_context_on_end(int ssl, struct us_socket_context_t *context, struct us_socket_t *(*on_end)(struct us_socket_t *s));
 
+/* Emitted with descriptors passed over a unix socket of this context (us_socket_write_fds), before the bytes they
+ * came with are emitted as on_data. They are owned by the callback, to adopt or close. Sockets of contexts with
+ * this set read with recvmsg. Plain contexts only */
+void us_socket_context_on_fds(int ssl, struct us_socket_context_t *context,
+    struct us_socket_t *(*on_fds)(struct us_socket_t *s, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds));
+
 /* Returns user data extension for this socket context */
 void *us_socket_context_ext(int ssl, struct us_socket_context_t *context);
 
@@ -198,20 +218,139 @@ struct us_listen_socket_t *us_socket_context_listen(int ssl, struct us_socket_co
 struct us_listen_socket_t *us_socket_context_listen_unix(int ssl, struct us_socket_context_t *context,
     const char *path, int options, int socket_ext_size);
 
+/* Polls a listening descriptor, such as one passed on by the process this one replaces (us_socket_write_fds),
+ * as a listen socket of this context. Connections queued on it meanwhile are accepted as usual. Returns null,
+ * leaving fd to the caller, if it is not listening */
+struct us_listen_socket_t *us_socket_context_adopt_listen_socket(int ssl, struct us_socket_context_t *context,
+    LIBUS_SOCKET_DESCRIPTOR fd, int socket_ext_size);
+
+/* Accepts on listen socket ls of another loop from the loop of context as well, instead of a SO_REUSEPORT
+ * socket per loop. With epoll only one waiting loop is woken per connection (EPOLLEXCLUSIVE), so a busy loop
+ * does not strand connections hashed to it. That leaves out ls itself, woken for each; a loop can share ls
+ * with itself and close ls to be woken in turn too. Call before the loop of context runs or from its thread, and
+ * close each returned listen socket on its own loop. Returns null on failure, or where descriptors cannot be
+ * duplicated (Windows) */
+struct us_listen_socket_t *us_socket_context_share_listen_socket(int ssl, struct us_socket_context_t *context,
+    struct us_listen_socket_t *ls, int socket_ext_size);
+
 /* listen_socket.c/.h */
 void us_listen_socket_close(int ssl, struct us_listen_socket_t *ls);
 
+/* Stops accepting on a listen socket while keeping it bound, so that new connections queue in the kernel backlog
+ * until resumed */
+void us_listen_socket_pause(int ssl, struct us_listen_socket_t *ls);
+
+/* Accepts again on a paused listen socket, unless its context is shedding load */
+void us_listen_socket_resume(int ssl, struct us_listen_socket_t *ls);
+
+/* Returns whether a listen socket is accepting, neither paused nor held back by shedding */
+int us_listen_socket_is_accepting(int ssl, struct us_listen_socket_t *ls);
+
+/* Holds back the listen sockets of context while it has max_sockets sockets or more, connecting ones included,
+ * and while its loop is at overload level or above (us_loop_on_overload), accepting again once neither holds.
+ * 0 turns either off */
+void us_socket_context_shed_load(int ssl, struct us_socket_context_t *context, unsigned int max_sockets, int level);
+
+/* Admission limits of a context, 0 for unlimited */
+struct us_socket_context_limits_t {
+    /* Sockets of the context, connecting ones included */
+    unsigned int max_sockets;
+    /* Outgoing connections not established yet */
+    unsigned int max_connecting;
+    /* SSL sockets still in their handshake */
+    unsigned int max_handshaking;
+    /* Turn connections away, over these limits or those of us_loop_limit_ips, with a reset instead of a FIN,
+     * leaving no TIME_WAIT behind */
+    int reset;
+};
+
+/* Why a connection was turned away */
+enum {
+    LIBUS_REJECT_SOCKETS,
+    LIBUS_REJECT_CONNECTING,
+    LIBUS_REJECT_HANDSHAKING,
+    /* By the limits of us_loop_limit_ips */
+    LIBUS_REJECT_IP_RATE,
+    LIBUS_REJECT_IP_CONNECTIONS,
+    LIBUS_REJECT_TYPES
+};
+
+/* Connections accepted over a limit are closed right away, without on_pre_open, on_open or any allocation.
+ * Connecting over a limit fails, us_socket_context_connect returning null. A null limits lifts all of them */
+void us_socket_context_set_limits(int ssl, struct us_socket_context_t *context, const struct us_socket_context_limits_t *limits);
+
+/* Returns how many connections were turned away for reason LIBUS_REJECT_*, from any thread */
+unsigned long long us_socket_context_rejected(int ssl, struct us_socket_context_t *context, int reason);
+
+/* Limits on what each source address may open, sources being told apart by address prefix */
+struct us_ip_limits_t {
+    /* New connections per second, in bursts of up to burst (rate by default). 0 for no rate limit */
+    unsigned int rate;
+    unsigned int burst;
+    /* Connections open at once, 0 for no limit */
+    unsigned int max_connections;
+    /* Prefix lengths, 32 and 64 by default */
+    int ipv4_prefix;
+    int ipv6_prefix;
+    /* Sources tracked at once, 16384 by default. Connections of sources past that are let through */
+    unsigned int max_sources;
+};
+
+/* Limits accepting on all listen sockets of loop by source address. Connections over a limit are closed right
+ * after accept, as with us_socket_context_set_limits, and counted in the rejections of the listening context.
+ * Unix sockets are not limited. A null limits lifts them */
+void us_loop_limit_ips(struct us_loop_t *loop, const struct us_ip_limits_t *limits);
+
+/* Returns the descriptor of a listen socket, for passing on to another process */
+LIBUS_SOCKET_DESCRIPTOR us_listen_socket_fd(struct us_listen_socket_t *ls);
+
+/* Stops accepting by closing the listen sockets of context, then closes its sockets still open after seconds.
+ * The loop is kept alive until then or until the last socket closed. Calling it again moves the deadline */
+void us_socket_context_drain(int ssl, struct us_socket_context_t *context, unsigned int seconds);
+
 /* Adopt a socket which was accepted either internally, or from another accept() outside libusockets */
 struct us_socket_t *us_adopt_accepted_socket(int ssl, struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR client_fd,
     unsigned int socket_ext_size, char *addr_ip, int addr_ip_length);
 
-/* Land in on_open or on_connection_error or return null or return socket */
+/* Adopts a connected socket received from another process (us_socket_context_on_fds) as if accepted here, emitting
+ * on_open with its remote address and then on_data with length bytes the sender already read off it, if any.
+ * A TLS session cannot move between processes, so SSL sockets are handed over before their handshake, which the
+ * adopting context does; the sender may pass on what it peeked of the ClientHello as data. Returns null, leaving
+ * fd to the caller, if it is not a connected socket */
+struct us_socket_t *us_adopt_received_socket(int ssl, struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR fd,
+    unsigned int socket_ext_size, char *data, int length);
+
+/* Land in on_open or on_connection_error or return null or return socket. With epoll and kqueue host names
+ * are resolved on a thread pool, so failing to resolve one lands in on_connect_error rather than returning null.
+ * These also race the addresses of a host name (Happy Eyeballs), alternating IPv6 and IPv4, keeping the first to connect */
 struct us_socket_t *us_socket_context_connect(int ssl, struct us_socket_context_t *context,
     const char *host, int port, const char *source_host, int options, int socket_ext_size);
 
 struct us_socket_t *us_socket_context_connect_unix(int ssl, struct us_socket_context_t *context,
     const char *server_path, int options, int socket_ext_size);
 
+struct us_connect_many_options_t {
+    /* Source addresses connections take turns binding to, each having its own ephemeral ports. None lets the system pick */
+    const char **source_hosts;
+    int source_host_count;
+    /* Connects started every interval_ms, all at once if 0 */
+    int per_tick;
+    /* Defaults to 1 ms */
+    unsigned int interval_ms;
+    /* LIBUS_CONNECT_* */
+    int options;
+    /* Called with how many connects were started once no more will be, possibly before connect_many returns */
+    void (*on_done)(struct us_socket_context_t *context, int started);
+};
+
+/* Opens count connections to the first address of host, each landing in on_open or on_connect_error. The host is
+ * resolved once with a blocking call on the calling thread, stalling the loop for as long as resolving takes if
+ * that is its thread; numeric hosts do not block. Connects that cannot be started, out of descriptors or ports,
+ * are tried again the next tick while the context has sockets open and dropped otherwise. Connects not started
+ * yet are dropped when the context closes. Returns 0 if host or all source hosts failed to resolve */
+int us_socket_context_connect_many(int ssl, struct us_socket_context_t *context, const char *host, int port, int count,
+    int socket_ext_size, struct us_connect_many_options_t options);
+
 /* Is this socket established? Can be used to check if a connecting socket has fired the on_open event yet.
  * Can also be used to determine if a socket is a listen_socket or not, but you probably know that already. */
 int us_socket_is_established(int ssl, struct us_socket_t *s);
@@ -232,12 +371,98 @@ struct us_socket_t *us_socket_context_adopt_socket(int ssl, struct us_socket_con
  * parent socket context for some shared resources. Child socket contexts should be used together with socket adoptions and nothing else. */
 struct us_socket_context_t *us_create_child_socket_context(int ssl, struct us_socket_context_t *context, int context_ext_size);
 
+/* Options for us_socket_context_pool, zero means default */
+struct us_pool_options_t {
+    /* Idle connections kept per host and port, defaults to 8 */
+    int max_idle;
+    /* Connections per host and port, idle, in use or connecting, defaults to unlimited */
+    int max_total;
+    /* Seconds an idle connection is kept, defaults to as long as the server keeps it open */
+    unsigned int idle_timeout;
+};
+
+/* Keeps connections released with us_pool_release for reuse by us_pool_acquire on this context. Connections are
+ * keyed by host and port as connected to, a context being either SSL or not. Idle ones are closed without
+ * emitting on_close when the server ends them, sends anything or idle_timeout passes */
+void us_socket_context_pool(int ssl, struct us_socket_context_t *context, struct us_pool_options_t options);
+
+/* Returns an idle connection to host and port with reused set, or connects like us_socket_context_connect.
+ * Returns null if max_total connections are open already or the connect failed */
+struct us_socket_t *us_pool_acquire(int ssl, struct us_socket_context_t *context, const char *host, int port, int options,
+    int socket_ext_size, int *reused);
+
+/* Hands a connection back once it is done with its request, with nothing left to read. Connections not from
+ * us_pool_acquire or beyond max_idle are closed instead, those still connecting without emitting on_close.
+ * Returns the socket, which may have moved, for the callback it is released from to return */
+struct us_socket_t *us_pool_release(int ssl, struct us_socket_t *s);
+
+/* Public interfaces for acceptors */
+
+/* Which worker an acceptor hands the next connection to */
+enum {
+    /* Workers take turns */
+    LIBUS_ACCEPTOR_ROUND_ROBIN,
+    /* The worker with the fewest connections, open or queued */
+    LIBUS_ACCEPTOR_LEAST_CONNECTIONS,
+    /* The worker quickest to pick up what it was handed lately, ties broken by connections */
+    LIBUS_ACCEPTOR_LEAST_LATENCY
+};
+
+/* What a custom policy knows of each worker */
+struct us_acceptor_worker_stats_t {
+    int connections;
+    /* Handed over but not picked up yet */
+    int queued;
+    /* Microseconds a worker took from wakeup to picking up connections, smoothed */
+    unsigned int latency_us;
+};
+
+struct us_acceptor_t;
+
+/* Accepts connections on loop and hands them to worker loops, normally running on other threads, which
+ * adopt them. An alternative to SO_REUSEPORT when its hashing spreads few heavy clients unevenly. Add the
+ * workers and listen before any of the loops run, workers keep their loops running until the acceptor closes.
+ * Connections no worker has room for are closed */
+struct us_acceptor_t *us_create_acceptor(struct us_loop_t *loop, int policy);
+
+/* Picks workers with policy instead, which returns the index of one or -1 to close the connection */
+void us_acceptor_set_policy(struct us_acceptor_t *acceptor, int (*policy)(struct us_acceptor_worker_stats_t *workers,
+    int num_workers, void *user_data), void *user_data);
+
+/* Connections handed to this worker are adopted into context on its loop, emitting on_open there. The limits of
+ * context (us_socket_context_set_limits) and of its loop (us_loop_limit_ips) are applied as they are adopted.
+ * A context is a worker of one acceptor at most. Returns 0 on failure */
+int us_acceptor_add_worker(struct us_acceptor_t *acceptor, int ssl, struct us_socket_context_t *context, int socket_ext_size);
+
+/* Listens like us_socket_context_listen, from the acceptor's loop */
+struct us_listen_socket_t *us_acceptor_listen(struct us_acceptor_t *acceptor, const char *host, int port, int options);
+
+/* Stops listening, from the acceptor's thread. Worker loops no longer wait for connections from it */
+void us_acceptor_close(struct us_acceptor_t *acceptor);
+
+/* Frees the acceptor once none of its loops run, before any of them is freed. Connections handed
+ * over but not picked up yet are closed */
+void us_acceptor_free(struct us_acceptor_t *acceptor);
+
 /* Public interfaces for loops */
 
+/* Options for us_create_loop_with_options, zero means default */
+struct us_loop_options_t {
+    /* Size of the receive buffer shared by all sockets of the loop, defaults to LIBUS_RECV_BUFFER_LENGTH */
+    int recv_buffer_length;
+    /* Start reading small and grow per socket as long as reads fill what we asked for, shrink again
+     * when they use less than a quarter. Keeps the shared buffers cache-hot for small-message workloads */
+    int adaptive_read_size;
+};
+
 /* Returns a new event loop with user data extension */
 struct us_loop_t *us_create_loop(void *hint, void (*wakeup_cb)(struct us_loop_t *loop),
     void (*pre_cb)(struct us_loop_t *loop), void (*post_cb)(struct us_loop_t *loop), unsigned int ext_size);
 
+/* Same as us_create_loop but with options */
+struct us_loop_t *us_create_loop_with_options(void *hint, void (*wakeup_cb)(struct us_loop_t *loop),
+    void (*pre_cb)(struct us_loop_t *loop), void (*post_cb)(struct us_loop_t *loop), unsigned int ext_size, struct us_loop_options_t options);
+
 /* Frees the loop immediately */
 void us_loop_free(struct us_loop_t *loop);
 
@@ -260,6 +485,165 @@ void us_loop_integrate(struct us_loop_t *loop);
 /* Returns the loop iteration number */
 long long us_loop_iteration_number(struct us_loop_t *loop);
 
+/* Caps how many bytes one socket may read per loop iteration, the rest is read next iteration after
+ * other ready sockets had their turn. Defaults to 0, meaning no limit */
+void us_loop_set_read_quota(struct us_loop_t *loop, unsigned int bytes);
+
+/* Caches what host names of outbound connects resolve to, for ttl seconds, and names that do not exist for
+ * negative_ttl seconds. The resolver does not tell us record TTLs so these apply to every name. Connects to a
+ * name already being resolved wait for that resolution. Defaults to 0, meaning no cache, which also flushes it */
+void us_loop_set_dns_cache(struct us_loop_t *loop, unsigned int ttl, unsigned int negative_ttl);
+
+struct us_dns_cache_stats_t {
+    /* Connects served from the cache or joining a resolution in flight */
+    unsigned long long hits;
+    /* Connects failed right away for a name cached as not existing */
+    unsigned long long negative_hits;
+    /* Connects which had to resolve their name */
+    unsigned long long misses;
+    int entries;
+};
+
+/* Counters of a loop since it was created, collected in builds with LIBUS_USE_METRICS (WITH_METRICS=1) only */
+struct us_loop_stats_t {
+    unsigned long long iterations;
+    /* Ready polls dispatched, by poll type */
+    unsigned long long socket_events;
+    unsigned long long semi_socket_events;
+    unsigned long long callback_events;
+    /* Nanoseconds blocked waiting for events, and spent in the rest of the iterations (epoll and kqueue only) */
+    unsigned long long wait_ns;
+    unsigned long long dispatch_ns;
+    unsigned long long recv_calls;
+    unsigned long long recv_bytes;
+    unsigned long long send_calls;
+    unsigned long long send_bytes;
+    /* Writes the kernel took only part of, the socket then waits for writable */
+    unsigned long long partial_writes;
+    unsigned long long accepts;
+    unsigned long long closes;
+    /* Sockets open now, connecting ones included */
+    unsigned long long sockets;
+    /* Sockets in the low-priority queue now, and how many times sockets were put there */
+    unsigned long long low_prio_queued;
+    unsigned long long low_prio_deferrals;
+    /* Timeout sweeps and nanoseconds they took */
+    unsigned long long sweeps;
+    unsigned long long sweep_ns;
+    unsigned long long sweep_max_ns;
+};
+
+/* Fills stats with the counters of the loop, from any thread. All zero without LIBUS_USE_METRICS */
+void us_loop_stats(struct us_loop_t *loop, struct us_loop_stats_t *stats);
+
+/* Overload levels of a loop (us_loop_on_overload) */
+enum {
+    LIBUS_OVERLOAD_NONE,
+    LIBUS_OVERLOAD_WARNING,
+    LIBUS_OVERLOAD_CRITICAL
+};
+
+/* How late a loop runs, averaged over recent iterations */
+struct us_loop_lag_t {
+    /* From polling returning to the end of the iteration, what the last socket found ready waited for its turn
+     * (epoll and kqueue only) */
+    unsigned int lag_us;
+    /* Whole iterations, waiting included */
+    unsigned int iteration_us;
+    /* The lag of the last iteration alone */
+    unsigned int last_lag_us;
+    int level;
+};
+
+/* Measures lag from now on and calls on_overload from the loop as the averaged lag reaches warning_us or
+ * critical_us, and again as it drops below three quarters of that, with the level now. Applications may then
+ * pause accepting, turn requests away early or lower the low-priority budget. A 0 on_overload stops measuring */
+void us_loop_on_overload(struct us_loop_t *loop, unsigned int warning_us, unsigned int critical_us,
+    void (*on_overload)(struct us_loop_t *loop, int level));
+
+/* Fills lag with what was measured, from the loop's thread. All zero unless us_loop_on_overload is set */
+void us_loop_lag(struct us_loop_t *loop, struct us_loop_lag_t *lag);
+
+/* Sockets the low-priority queue (SSL handshakes) lets through per iteration, 5 by default and at least 1 */
+void us_loop_set_low_priority_budget(struct us_loop_t *loop, int sockets);
+
+/* Buckets four per power of two: 0 to 3 exact, then [4, 5) up to [7, 8), [8, 10) up to [14, 16) and so on. The
+ * last bucket holds everything from 7 << 22 */
+#define LIBUS_HISTOGRAM_BUCKETS 96
+
+struct us_histogram_t {
+    unsigned long long count;
+    unsigned long long total;
+    unsigned int max;
+    unsigned int buckets[LIBUS_HISTOGRAM_BUCKETS];
+};
+
+/* Lowest value counted in a bucket */
+unsigned int us_histogram_bucket_floor(int bucket);
+
+/* Value below which the given percentile (0 to 100) of the samples fell, to bucket precision */
+unsigned int us_histogram_percentile(struct us_histogram_t *histogram, double percentile);
+
+/* Callbacks timed in builds with LIBUS_USE_CALLBACK_TIMING (WITH_CALLBACK_TIMING=1) */
+enum {
+    LIBUS_CALLBACK_OPEN,
+    LIBUS_CALLBACK_DATA,
+    LIBUS_CALLBACK_WRITABLE,
+    LIBUS_CALLBACK_END,
+    LIBUS_CALLBACK_CONNECT_ERROR,
+    LIBUS_CALLBACK_TIMEOUT,
+    LIBUS_CALLBACK_LONG_TIMEOUT,
+    LIBUS_CALLBACK_TYPES
+};
+
+/* Copies how many microseconds callbacks of one type took for the context, from any thread. Returns 0 with
+ * nothing recorded (or without LIBUS_USE_CALLBACK_TIMING) */
+int us_socket_context_callback_histogram(int ssl, struct us_socket_context_t *context, int type, struct us_histogram_t *histogram);
+
+/* Calls handler after any timed callback of the loop which took threshold_us or longer, with its context and
+ * type. A 0 handler stops reporting. Does nothing without LIBUS_USE_CALLBACK_TIMING */
+void us_loop_on_slow_callback(struct us_loop_t *loop, unsigned int threshold_us,
+    void (*handler)(struct us_socket_context_t *context, int type, unsigned int elapsed_us));
+
+/* What us_socket_context_sample_tcp_info collects */
+enum {
+    LIBUS_TCP_INFO_RTT_US,
+    LIBUS_TCP_INFO_CWND,
+    LIBUS_TCP_INFO_RETRANSMITS,
+    LIBUS_TCP_INFO_UNACKED_BYTES,
+    LIBUS_TCP_INFO_TYPES
+};
+
+/* Samples us_socket_tcp_info of one in every one_in sockets of the context at each timeout sweep, a different
+ * one each sweep, into histograms of the context. Sockets not sampled cost no syscall. 0 stops sampling and keeps
+ * what was collected */
+void us_socket_context_sample_tcp_info(int ssl, struct us_socket_context_t *context, unsigned int one_in);
+
+/* Copies what was sampled of one kind (LIBUS_TCP_INFO_*) for the context, from any thread. Returns 0 with nothing
+ * sampled */
+int us_socket_context_tcp_info_histogram(int ssl, struct us_socket_context_t *context, int type, struct us_histogram_t *histogram);
+
+/* Serves GET /metrics in Prometheus text format from a socket context of its own on the loop: the counters of
+ * the loops added summed up, and callback and TCP_INFO histograms of the contexts added. Needs LIBUS_USE_METRICS
+ * for the counters to count and LIBUS_USE_CALLBACK_TIMING for callback histograms. Returns 0 if it cannot listen */
+struct us_metrics_exporter_t;
+struct us_metrics_exporter_t *us_create_metrics_exporter(struct us_loop_t *loop, const char *host, int port, int options);
+
+/* Loops and contexts may run on other threads. Add them from the thread of the exporter's loop, and keep them
+ * until the exporter is freed. Return 0 on failure */
+int us_metrics_exporter_add_loop(struct us_metrics_exporter_t *exporter, struct us_loop_t *loop);
+int us_metrics_exporter_add_context(struct us_metrics_exporter_t *exporter, int ssl, struct us_socket_context_t *context, const char *name);
+
+/* The listen socket, to find the port when listening on port 0 */
+struct us_listen_socket_t *us_metrics_exporter_listen_socket(struct us_metrics_exporter_t *exporter);
+
+/* Stops listening and closes scrapes in progress, free once the loop no longer runs them */
+void us_metrics_exporter_close(struct us_metrics_exporter_t *exporter);
+void us_metrics_exporter_free(struct us_metrics_exporter_t *exporter);
+
+/* Fills stats with the counters of the DNS cache of the loop */
+void us_loop_dns_cache_stats(struct us_loop_t *loop, struct us_dns_cache_stats_t *stats);
+
 /* Public interfaces for polls */
 
 /* A fallthrough poll does not keep the loop running, it falls through */
@@ -302,6 +686,11 @@ int us_socket_write(int ssl, struct us_socket_t *s, const char *data, int length
 /* Special path for non-SSL sockets. Used to send header and payload in one go. Works like us_socket_write. */
 int us_socket_write2(int ssl, struct us_socket_t *s, const char *header, int header_length, const char *payload, int payload_length);
 
+/* Passes up to LIBUS_MAX_PASSED_FDS descriptors over a plain unix socket along with the first byte of data, which must
+ * not be empty. Works like us_socket_write, the descriptors went along if anything was written. The sender keeps its
+ * own copies of them open until it closes them */
+int us_socket_write_fds(int ssl, struct us_socket_t *s, const char *data, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds);
+
 /* Set a low precision, high performance timer on a socket. A socket can only have one single active timer
  * at any given point in time. Will remove any such pre set timer */
 void us_socket_timeout(int ssl, struct us_socket_t *s, unsigned int seconds);
@@ -326,6 +715,22 @@ void us_socket_shutdown(int ssl, struct us_socket_t *s);
  * to next event loop iteration. */
 void us_socket_shutdown_read(int ssl, struct us_socket_t *s);
 
+/* Stops reading from the socket until resumed, so that TCP flow control pushes back on the sender.
+ * No on_data is emitted while paused, writing and timeouts work as usual */
+void us_socket_pause(int ssl, struct us_socket_t *s);
+
+/* Resumes reading from a paused socket. For SSL, plaintext already decrypted but held back while
+ * paused is emitted from the next loop iteration on, never from within this call */
+void us_socket_resume(int ssl, struct us_socket_t *s);
+
+/* Returns whether reading from the socket is paused */
+int us_socket_is_paused(int ssl, struct us_socket_t *s);
+
+/* Makes reads from this socket go straight into buffer, up to length bytes at a time, instead of the shared
+ * receive buffer. on_data then points into buffer, so move it forward (or pass null to go back to the shared
+ * buffer) from within on_data as it fills up. Returns 0 for SSL sockets, which always decrypt into the shared buffer */
+int us_socket_set_read_buffer(int ssl, struct us_socket_t *s, char *buffer, int length);
+
 /* Returns whether the socket has been shut down or not */
 int us_socket_is_shut_down(int ssl, struct us_socket_t *s);
 
@@ -344,6 +749,61 @@ int us_socket_remote_port(int ssl, struct us_socket_t *s);
 /* Copy remote (IP) address of socket, or fail with zero length. */
 void us_socket_remote_address(int ssl, struct us_socket_t *s, char *buf, int *length);
 
+/* What the kernel knows of a TCP connection */
+struct us_tcp_info_t {
+    /* Smoothed round trip time and its variation */
+    unsigned int rtt_us;
+    unsigned int rtt_var_us;
+    /* Congestion window in segments, and the segment size */
+    unsigned int cwnd;
+    unsigned int mss;
+    /* Segments retransmitted over the life of the connection */
+    unsigned int total_retransmits;
+    /* Bytes sent and not acknowledged yet, to segment precision */
+    unsigned int unacked_bytes;
+};
+
+/* Fills info with the kernel's view of the connection (TCP_INFO). Returns 0 where that is not available
+ * (other than Linux, or not a TCP socket) */
+int us_socket_tcp_info(int ssl, struct us_socket_t *s, struct us_tcp_info_t *info);
+
+/* Forwards everything read from a to b and from b to a inside the kernel (splice), without emitting on_data
+ * or on_writable for either socket. Backpressure is applied per direction by pausing reads from the sender.
+ * Timeouts and on_close still fire. Only plain TCP sockets of the same loop on Linux can be piped,
+ * returns 1 on success or 0 if piping is not supported for these sockets. */
+int us_socket_pipe(int ssl_a, struct us_socket_t *a, int ssl_b, struct us_socket_t *b);
+
+/* Returns a piped socket and its peer to normal callback mode. Data already taken off a socket but not yet
+ * forwarded is emitted as on_data of that socket. Returns the (possibly new) socket. A piped socket receiving
+ * FIN emits on_end as usual while the other direction stays piped; closing one side of a pipe unpipes the other.
+ * On hangup, data the peer could not take without blocking is emitted as on_data before on_close. */
+struct us_socket_t *us_socket_unpipe(int ssl, struct us_socket_t *s);
+
+/* How frames announce their length */
+enum {
+    /* 2 or 4 byte unsigned integer, big endian unless little_endian is set */
+    LIBUS_FRAME_LENGTH_U16,
+    LIBUS_FRAME_LENGTH_U32,
+    /* Unsigned LEB128 (protobuf style) of at most 5 bytes */
+    LIBUS_FRAME_LENGTH_VARINT
+};
+
+struct us_frame_options_t {
+    int length_format;
+    int little_endian;
+    /* Bytes of fixed header preceding the length field, such as a message type */
+    int length_offset;
+    /* Sockets announcing a larger payload are closed, 0 means 16 MB. At most INT_MAX less the header */
+    unsigned int max_payload_length;
+};
+
+/* Splits the byte stream of every socket of this context into length-prefixed frames, emitted as on_message
+ * instead of on_data. Header is the fixed header followed by the length field, payload is what the length
+ * field counts. Frames arriving whole are passed straight out of the receive buffer, only a frame straddling
+ * reads is reassembled in a buffer taken from a per-loop pool. Replaces on_data and owns the socket's read buffer */
+void us_socket_context_frame(int ssl, struct us_socket_context_t *context, struct us_frame_options_t options,
+    struct us_socket_t *(*on_message)(struct us_socket_t *s, char *header, int header_length, char *payload, int length));
+
 #ifdef __cplusplus
 }
 #endif
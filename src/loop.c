@@ -22,18 +22,45 @@
 #include "libusockets.h"
 #include "internal/internal.h"
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* We do not want to block the loop with tons and tons of CPU-intensive work for SSL handshakes.
+ * Spread it out during many loop iterations, prioritizing already open connections, they are far
+ * easier on CPU */
+static const int MAX_LOW_PRIO_SOCKETS_PER_LOOP_ITERATION = 5;
 
 /* The loop has 2 fallthrough polls */
 void us_internal_loop_data_init(struct us_loop_t *loop, void (*wakeup_cb)(struct us_loop_t *loop),
     void (*pre_cb)(struct us_loop_t *loop), void (*post_cb)(struct us_loop_t *loop)) {
     loop->data.sweep_timer = us_create_timer(loop, 1, 0);
     loop->data.recv_buf = malloc(LIBUS_RECV_BUFFER_LENGTH + LIBUS_RECV_BUFFER_PADDING * 2);
+    loop->data.recv_buf_length = LIBUS_RECV_BUFFER_LENGTH;
+    loop->data.adaptive_read_size = 0;
     loop->data.ssl_data = 0;
     loop->data.head = 0;
     loop->data.iterator = 0;
     loop->data.closed_head = 0;
     loop->data.low_prio_head = 0;
     loop->data.low_prio_budget = 0;
+    loop->data.low_prio_max = MAX_LOW_PRIO_SOCKETS_PER_LOOP_ITERATION;
+    loop->data.lag_monitor = 0;
+    loop->data.read_quota = 0;
+    loop->data.frame_pool = 0;
+    loop->data.frame_pool_length = 0;
+    loop->data.resolver = 0;
+    loop->data.dns_cache = 0;
+    loop->data.ip_limiter = 0;
+    loop->data.ip_limiter_seed = 0;
+    loop->data.acceptor_workers = 0;
+    loop->data.acceptor_async = 0;
+#ifdef LIBUS_USE_METRICS
+    memset(&loop->data.stats, 0, sizeof(loop->data.stats));
+#endif
+#ifdef LIBUS_USE_CALLBACK_TIMING
+    loop->data.slow_callback_us = 0;
+    loop->data.on_slow_callback = 0;
+#endif
 
     loop->data.pre_cb = pre_cb;
     loop->data.post_cb = post_cb;
@@ -49,15 +76,63 @@ void us_internal_loop_data_free(struct us_loop_t *loop) {
 #endif
 
     free(loop->data.recv_buf);
+    us_internal_frame_pool_free(loop);
+    us_internal_resolver_free(loop);
+    us_internal_dns_cache_free(loop);
+    us_internal_ip_limiter_free(loop);
+    free(loop->data.lag_monitor);
 
     us_timer_close(loop->data.sweep_timer);
     us_internal_async_close(loop->data.wakeup_async);
 }
 
+struct us_loop_t *us_create_loop_with_options(void *hint, void (*wakeup_cb)(struct us_loop_t *loop),
+    void (*pre_cb)(struct us_loop_t *loop), void (*post_cb)(struct us_loop_t *loop), unsigned int ext_size, struct us_loop_options_t options) {
+    struct us_loop_t *loop = us_create_loop(hint, wakeup_cb, pre_cb, post_cb, ext_size);
+
+    if (options.recv_buffer_length > 0 && options.recv_buffer_length != loop->data.recv_buf_length) {
+        free(loop->data.recv_buf);
+        loop->data.recv_buf = malloc(options.recv_buffer_length + LIBUS_RECV_BUFFER_PADDING * 2);
+        loop->data.recv_buf_length = options.recv_buffer_length;
+    }
+    loop->data.adaptive_read_size = options.adaptive_read_size;
+
+    return loop;
+}
+
 void us_wakeup_loop(struct us_loop_t *loop) {
     us_internal_async_wakeup(loop->data.wakeup_async);
 }
 
+void us_loop_stats(struct us_loop_t *loop, struct us_loop_stats_t *stats) {
+#ifdef LIBUS_USE_METRICS
+    /* Every field is a counter of the same type */
+    unsigned long long *from = (unsigned long long *) &loop->data.stats, *to = (unsigned long long *) stats;
+    for (size_t i = 0; i < sizeof(struct us_loop_stats_t) / sizeof(unsigned long long); i++) {
+#ifdef _MSC_VER
+        to[i] = *(volatile unsigned long long *) &from[i];
+#else
+        to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+#endif
+    }
+#else
+    memset(stats, 0, sizeof(struct us_loop_stats_t));
+#endif
+}
+
+long long us_internal_now_ns() {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (long long) (counter.QuadPart * (1000000000.0 / frequency.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
 void us_internal_loop_link(struct us_loop_t *loop, struct us_socket_context_t *context) {
     /* Insert this context as the head of loop */
     context->next = loop->data.head;
@@ -85,6 +160,7 @@ void us_internal_loop_unlink(struct us_loop_t *loop, struct us_socket_context_t
 
 /* This functions should never run recursively */
 void us_internal_timer_sweep(struct us_loop_t *loop) {
+    US_METRIC_CLOCK(sweep_start);
     struct us_internal_loop_data_t *loop_data = &loop->data;
     /* For all socket contexts in this loop */
     for (loop_data->iterator = loop_data->head; loop_data->iterator; loop_data->iterator = loop_data->iterator->next) {
@@ -96,6 +172,11 @@ void us_internal_timer_sweep(struct us_loop_t *loop) {
         unsigned char short_ticks = context->timestamp = context->global_tick % 240;
         unsigned char long_ticks = context->long_timestamp = (context->global_tick / 15) % 240;
 
+        /* Emits nothing, so the timeouts below see the same chain */
+        if (context->tcp_sampler) {
+            us_internal_tcp_info_sample(context);
+        }
+
         /* Begin at head */
         struct us_socket_t *s = context->head_sockets;
         while (s) {
@@ -117,12 +198,18 @@ void us_internal_timer_sweep(struct us_loop_t *loop) {
 
             if (short_ticks == s->timeout) {
                 s->timeout = 255;
+                US_PROBE2(timeout, s, 0);
+                US_CALLBACK_BEGIN(timing, context);
                 context->on_socket_timeout(s);
+                US_CALLBACK_END(timing, LIBUS_CALLBACK_TIMEOUT);
             }
 
             if (context->iterator == s && long_ticks == s->long_timeout) {
                 s->long_timeout = 255;
+                US_PROBE2(timeout, s, 1);
+                US_CALLBACK_BEGIN(timing, context);
                 context->on_socket_long_timeout(s);
+                US_CALLBACK_END(timing, LIBUS_CALLBACK_LONG_TIMEOUT);
             }   
 
             /* Check for unlink / link (if the event handler did not modify the chain, we step 1) */
@@ -137,18 +224,26 @@ void us_internal_timer_sweep(struct us_loop_t *loop) {
         next_context:
         context->iterator = 0;
     }
+
+    US_METRIC_CLOCK(sweep_end);
+    US_METRIC_ADD(loop, sweeps, 1);
+    US_METRIC_ADD(loop, sweep_ns, sweep_end - sweep_start);
+    US_METRIC_MAX(loop, sweep_max_ns, sweep_end - sweep_start);
 }
 
-/* We do not want to block the loop with tons and tons of CPU-intensive work for SSL handshakes.
- * Spread it out during many loop iterations, prioritizing already open connections, they are far
- * easier on CPU */
-static const int MAX_LOW_PRIO_SOCKETS_PER_LOOP_ITERATION = 5;
+void us_loop_set_low_priority_budget(struct us_loop_t *loop, int sockets) {
+    /* With none let through, queued handshakes would wait forever */
+    loop->data.low_prio_max = sockets < 1 ? 1 : sockets;
+}
+
+/* Smallest read we do with adaptive read sizing */
+static const int MIN_ADAPTIVE_READ_LENGTH = 4096;
 
 void us_internal_handle_low_priority_sockets(struct us_loop_t *loop) {
     struct us_internal_loop_data_t *loop_data = &loop->data;
     struct us_socket_t *s;
 
-    loop_data->low_prio_budget = MAX_LOW_PRIO_SOCKETS_PER_LOOP_ITERATION;
+    loop_data->low_prio_budget = loop_data->low_prio_max;
 
     for (s = loop_data->low_prio_head; s && loop_data->low_prio_budget > 0; s = loop_data->low_prio_head, loop_data->low_prio_budget--) {
         /* Unlink this socket from the low-priority queue */
@@ -157,7 +252,11 @@ void us_internal_handle_low_priority_sockets(struct us_loop_t *loop) {
         s->next = 0;
 
         us_internal_socket_context_link_socket(s->context, s);
-        us_poll_change(&s->p, us_socket_context(0, s)->loop, us_poll_events(&s->p) | LIBUS_SOCKET_READABLE);
+        US_METRIC_ADD(loop, low_prio_queued, -1);
+        /* Paused sockets start reading again on resume */
+        if (!(s->flags & SOCKET_FLAG_PAUSED)) {
+            us_poll_change(&s->p, us_socket_context(0, s)->loop, us_poll_events(&s->p) | LIBUS_SOCKET_READABLE);
+        }
 
         s->low_prio_state = 2;
     }
@@ -169,6 +268,10 @@ void us_internal_free_closed_sockets(struct us_loop_t *loop) {
     if (loop->data.closed_head) {
         for (struct us_socket_t *s = loop->data.closed_head; s; ) {
             struct us_socket_t *next = s->next;
+            if (s->aux && s->aux->frame_buffer) {
+                us_internal_frame_buffer_release(loop, s->aux->frame_buffer, s->aux->frame_buffer_capacity);
+            }
+            free(s->aux);
             us_poll_free((struct us_poll_t *) s, loop);
             s = next;
         }
@@ -184,16 +287,74 @@ long long us_loop_iteration_number(struct us_loop_t *loop) {
     return loop->data.iteration_nr;
 }
 
+void us_loop_set_read_quota(struct us_loop_t *loop, unsigned int bytes) {
+    loop->data.read_quota = bytes;
+}
+
+/* Sockets of contexts taking descriptors read with recvmsg, emitting descriptors before the bytes they came with.
+ * Returns -1 if the socket was closed from on_fds */
+static int us_internal_socket_recv(struct us_socket_t **s, char *buf, int length) {
+    if (!(*s)->context->on_fds) {
+        int received = bsd_recv(us_poll_fd(&(*s)->p), buf, length, 0);
+        US_METRIC_ADD((*s)->context->loop, recv_calls, 1);
+        US_METRIC_ADD((*s)->context->loop, recv_bytes, received > 0 ? received : 0);
+        return received;
+    }
+
+    LIBUS_SOCKET_DESCRIPTOR fds[LIBUS_MAX_PASSED_FDS];
+    int num_fds;
+    int received = bsd_recv_fds(us_poll_fd(&(*s)->p), buf, length, fds, &num_fds);
+    US_METRIC_ADD((*s)->context->loop, recv_calls, 1);
+    US_METRIC_ADD((*s)->context->loop, recv_bytes, received > 0 ? received : 0);
+    if (num_fds) {
+        *s = (*s)->context->on_fds(*s, fds, num_fds);
+        if (us_socket_is_closed(0, *s)) {
+            return -1;
+        }
+    }
+    return received;
+}
+
+/* Reads everything still queued, used when a socket hangs up after we deferred reading it */
+static struct us_socket_t *us_internal_socket_drain(struct us_socket_t *s) {
+    while (!us_socket_is_closed(0, s) && !(s->flags & SOCKET_FLAG_PAUSED)) {
+        char *buf = s->context->loop->data.recv_buf + LIBUS_RECV_BUFFER_PADDING;
+        int length = s->context->loop->data.recv_buf_length;
+        if (s->aux && s->aux->read_buffer) {
+            buf = s->aux->read_buffer;
+            length = s->aux->read_buffer_length;
+        }
+
+        if ((length = us_internal_socket_recv(&s, buf, length)) <= 0) {
+            break;
+        }
+        US_PROBE2(data, s, length);
+        US_CALLBACK_BEGIN(timing, s->context);
+        s = s->context->on_data(s, buf, length);
+        US_CALLBACK_END(timing, LIBUS_CALLBACK_DATA);
+    }
+    return s;
+}
+
 /* These may have somewhat different meaning depending on the underlying event library */
 void us_internal_loop_pre(struct us_loop_t *loop) {
     loop->data.iteration_nr++;
+    US_METRIC_ADD(loop, iterations, 1);
+    US_PROBE2(iteration_start, loop, loop->data.iteration_nr);
     us_internal_handle_low_priority_sockets(loop);
+#ifndef LIBUS_NO_SSL
+    us_internal_ssl_replay_held(loop);
+#endif
     loop->data.pre_cb(loop);
 }
 
 void us_internal_loop_post(struct us_loop_t *loop) {
     us_internal_free_closed_sockets(loop);
     loop->data.post_cb(loop);
+    US_PROBE1(iteration_end, loop);
+    if (loop->data.lag_monitor) {
+        us_internal_lag_end(loop);
+    }
 }
 
 struct us_socket_t *us_adopt_accepted_socket(int ssl, struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR accepted_fd,
@@ -201,9 +362,14 @@ struct us_socket_t *us_adopt_accepted_socket(int ssl, struct us_socket_context_t
 #ifndef LIBUS_NO_SSL
     if (ssl) {
         return (struct us_socket_t *)us_internal_ssl_adopt_accepted_socket((struct us_internal_ssl_socket_context_t *)context, accepted_fd,
-            socket_ext_size, addr_ip, addr_ip_length);
+            socket_ext_size, addr_ip, addr_ip_length, 0);
     }
 #endif
+    return us_internal_adopt_accepted_socket(context, accepted_fd, socket_ext_size, addr_ip, addr_ip_length, 0);
+}
+
+struct us_socket_t *us_internal_adopt_accepted_socket(struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR accepted_fd,
+    unsigned int socket_ext_size, char *addr_ip, int addr_ip_length, unsigned int source) {
     struct us_poll_t *accepted_p = us_create_poll(context->loop, 0, sizeof(struct us_socket_t) - sizeof(struct us_poll_t) + socket_ext_size);
     us_poll_init(accepted_p, accepted_fd, POLL_TYPE_SOCKET);
     us_poll_start(accepted_p, context->loop, LIBUS_SOCKET_READABLE);
@@ -214,13 +380,39 @@ struct us_socket_t *us_adopt_accepted_socket(int ssl, struct us_socket_context_t
     s->timeout = 255;
     s->long_timeout = 255;
     s->low_prio_state = 0;
+    s->aux = 0;
+    s->flags = source ? SOCKET_FLAG_IP_COUNTED : 0;
+    s->read_shift = 0;
+    s->source = source;
 
     /* We always use nodelay */
     bsd_socket_nodelay(accepted_fd, 1);
 
     us_internal_socket_context_link_socket(context, s);
+    US_METRIC_ADD(context->loop, sockets, 1);
 
+    US_PROBE2(open, s, 0);
+    US_CALLBACK_BEGIN(timing, context);
     context->on_open(s, 0, addr_ip, addr_ip_length);
+    US_CALLBACK_END(timing, LIBUS_CALLBACK_OPEN);
+    return s;
+}
+
+struct us_socket_t *us_adopt_received_socket(int ssl, struct us_socket_context_t *context, LIBUS_SOCKET_DESCRIPTOR fd,
+    unsigned int socket_ext_size, char *data, int length) {
+    struct bsd_addr_t addr;
+    if (bsd_remote_addr(fd, &addr)) {
+        return 0;
+    }
+
+    /* The sender may not have made it non-blocking, and SO_NOSIGPIPE does not travel with the descriptor */
+    struct us_socket_t *s = us_adopt_accepted_socket(ssl, context, bsd_set_nonblocking(apple_no_sigpipe(fd)), socket_ext_size,
+        bsd_addr_get_ip(&addr), bsd_addr_get_ip_length(&addr));
+
+    /* Bytes the sender read off the socket already, through the SSL layer if any */
+    if (length && !us_socket_is_closed(ssl, s)) {
+        s = s->context->on_data(s, data, length);
+    }
     return s;
 }
 
@@ -228,6 +420,7 @@ void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events)
     switch (us_internal_poll_type(p)) {
     case POLL_TYPE_CALLBACK: {
             struct us_internal_callback_t *cb = (struct us_internal_callback_t *) p;
+            US_METRIC_ADD(cb->loop, callback_events, 1);
             /* Timers, asyncs should accept (read), while UDP sockets should obviously not */
             if (!cb->leave_poll_ready) {
                 /* Let's just have this macro to silence the CodeQL alert regarding empty function when using libuv */
@@ -239,35 +432,66 @@ void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events)
         }
         break;
     case POLL_TYPE_SEMI_SOCKET: {
+            US_METRIC_ADD(((struct us_socket_t *) p)->context->loop, semi_socket_events, 1);
             /* Both connect and listen sockets are semi-sockets
              * but they poll for different events */
             if (us_poll_events(p) == LIBUS_SOCKET_WRITABLE) {
                 struct us_socket_t *s = (struct us_socket_t *) p;
 
+#ifdef LIBUS_USE_HAPPY_EYEBALLS
+                /* Racing attempts go on until one connects or all failed */
+                if (s->aux && s->aux->connect_race) {
+                    s = us_internal_connect_race_settle(s, &error);
+                    if (!s) {
+                        break;
+                    }
+                    /* A later attempt winning was closed, its descriptor now polled by the socket of the app */
+                    p = &s->p;
+                }
+#endif
+
                 /* It is perfectly possible to come here with an error */
                 if (error) {
                     /* Emit error, close without emitting on_close */
+                    US_CALLBACK_BEGIN(timing, s->context);
                     s->context->on_connect_error(s, 0);
+                    US_CALLBACK_END(timing, LIBUS_CALLBACK_CONNECT_ERROR);
                     us_socket_close_connecting(0, s);
                 } else {
-                    /* All sockets poll for readable */
-                    us_poll_change(p, s->context->loop, LIBUS_SOCKET_READABLE);
+                    /* We are now a proper socket, before polling like one: semi-sockets polling for readable
+                     * alone are listen sockets to the poll */
+                    us_internal_poll_set_type(p, POLL_TYPE_SOCKET);
+                    s->context->num_connecting--;
+
+                    /* All sockets poll for readable, unless paused while connecting */
+                    us_poll_change(p, s->context->loop, (s->flags & SOCKET_FLAG_PAUSED) ? 0 : LIBUS_SOCKET_READABLE);
 
                     /* We always use nodelay */
                     bsd_socket_nodelay(us_poll_fd(p), 1);
 
-                    /* We are now a proper socket */
-                    us_internal_poll_set_type(p, POLL_TYPE_SOCKET);
-
                     /* If we used a connection timeout we have to reset it here */
                     us_socket_timeout(0, s, 0);
 
+                    US_PROBE2(open, s, 1);
+                    US_CALLBACK_BEGIN(timing, s->context);
                     s->context->on_open(s, 1, 0, 0);
+                    US_CALLBACK_END(timing, LIBUS_CALLBACK_OPEN);
                 }
             } else {
                 struct us_listen_socket_t *listen_socket = (struct us_listen_socket_t *) p;
                 struct bsd_addr_t addr;
 
+                /* Paused earlier this iteration, connections wait in the backlog */
+                if (!us_poll_events(p)) {
+                    break;
+                }
+
+                /* What an acceptor accepts is adopted by its workers */
+                if (listen_socket->s.context->acceptor) {
+                    us_internal_acceptor_accept(listen_socket->s.context->acceptor, us_poll_fd(p));
+                    break;
+                }
+
                 LIBUS_SOCKET_DESCRIPTOR client_fd = bsd_accept_socket(us_poll_fd(p), &addr);
                 if (client_fd == LIBUS_SOCKET_ERROR) {
                     /* Todo: start timer here */
@@ -278,18 +502,30 @@ void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events)
 
                     do {
                         struct us_socket_context_t *context = us_socket_context(0, &listen_socket->s);
+                        US_METRIC_ADD(context->loop, accepts, 1);
+                        US_PROBE2(accept, us_poll_fd(p), client_fd);
+
+                        /* Turned away before anything is allocated for it */
+                        unsigned int source;
+                        if (!us_internal_socket_context_admit(context, client_fd, bsd_addr_get_ip(&addr), bsd_addr_get_ip_length(&addr), &source)) {
+                            continue;
+                        }
+
                         /* See if we want to export the FD or keep it here (this event can be unset) */
                         if (context->on_pre_open == 0 || context->on_pre_open(client_fd) == client_fd) {
 
                             /* Adopt the newly accepted socket */
-                            us_adopt_accepted_socket(0, context,
-                                client_fd, listen_socket->socket_ext_size, bsd_addr_get_ip(&addr), bsd_addr_get_ip_length(&addr));
+                            us_internal_adopt_accepted_socket(context,
+                                client_fd, listen_socket->socket_ext_size, bsd_addr_get_ip(&addr), bsd_addr_get_ip_length(&addr), source);
 
-                            /* Exit accept loop if listen socket was closed in on_open handler */
-                            if (us_socket_is_closed(0, &listen_socket->s)) {
+                            /* Exit accept loop if listen socket was closed or paused in on_open handler */
+                            if (us_socket_is_closed(0, &listen_socket->s) || !us_poll_events(p)) {
                                 break;
                             }
 
+                        } else if (source) {
+                            /* Exported, it no longer counts here */
+                            us_internal_ip_limiter_release(context->loop, source);
                         }
 
                     } while ((client_fd = bsd_accept_socket(us_poll_fd(p), &addr)) != LIBUS_SOCKET_ERROR);
@@ -301,20 +537,41 @@ void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events)
     case POLL_TYPE_SOCKET: {
             /* We should only use s, no p after this point */
             struct us_socket_t *s = (struct us_socket_t *) p;
+            US_METRIC_ADD(s->context->loop, socket_events, 1);
 
             /* Such as epollerr epollhup */
             if (error) {
+                /* A throttled pipe may still have data queued in the kernel */
+                if (s->aux && s->aux->pipe_peer) {
+                    s = us_internal_socket_pipe_hangup(s);
+                } else if ((s->flags & SOCKET_FLAG_READ_DEFERRED) || s->context->on_fds) {
+                    /* We left data behind due to the read quota, it comes before the hangup. So do descriptors
+                     * passed right before it, which would be lost otherwise */
+                    s = us_internal_socket_drain(s);
+                }
+
                 /* Todo: decide what code we give here */
                 s = us_socket_close(0, s, 0, NULL);
                 return;
             }
 
+            /* Piped sockets forward data kernel-side, only a FIN is left for the regular read path */
+            if (s->aux && s->aux->pipe_peer) {
+                if (!(s = us_internal_socket_pipe_dispatch(s, events))) {
+                    return;
+                }
+                events = LIBUS_SOCKET_READABLE;
+            }
+
             if (events & LIBUS_SOCKET_WRITABLE) {
                 /* Note: if we failed a write as a socket of one loop then adopted
                  * to another loop, this will be wrong. Absurd case though */
                 s->context->loop->data.last_write_failed = 0;
 
+                US_PROBE1(writable, s);
+                US_CALLBACK_BEGIN(timing, s->context);
                 s = s->context->on_writable(s);
+                US_CALLBACK_END(timing, LIBUS_CALLBACK_WRITABLE);
 
                 if (us_socket_is_closed(0, s)) {
                     return;
@@ -337,6 +594,7 @@ void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events)
                         s->context->loop->data.low_prio_budget--; /* Still having budget for this iteration - do normal processing */
                     } else {
                         us_poll_change(&s->p, us_socket_context(0, s)->loop, us_poll_events(&s->p) & LIBUS_SOCKET_WRITABLE);
+                        s->low_prio_state = 1;
                         us_internal_socket_context_unlink_socket(s->context, s);
 
                         /* Link this socket to the low-priority queue - we use a LIFO queue, to prioritize newer clients that are
@@ -347,23 +605,67 @@ void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events)
                         if (s->next) s->next->prev = s;
                         s->context->loop->data.low_prio_head = s;
 
-                        s->low_prio_state = 1;
+                        US_METRIC_ADD(s->context->loop, low_prio_queued, 1);
+                        US_METRIC_ADD(s->context->loop, low_prio_deferrals, 1);
+                        US_PROBE1(low_prio, s);
 
                         break;
                     }
                 }
 
-                int length;
+                int length, max_length, read_length, app_buffer;
+                char *buf;
+                unsigned int quota = s->context->loop->data.read_quota, total_length = 0;
+                s->flags &= ~SOCKET_FLAG_READ_DEFERRED;
                 read_more:
-                length = bsd_recv(us_poll_fd(&s->p), s->context->loop->data.recv_buf + LIBUS_RECV_BUFFER_PADDING, LIBUS_RECV_BUFFER_LENGTH, 0);
+                /* The app may have handed us its own buffer (or taken it back) from within on_data */
+                app_buffer = s->aux && s->aux->read_buffer;
+                if (app_buffer) {
+                    buf = s->aux->read_buffer;
+                    read_length = s->aux->read_buffer_length;
+                } else {
+                    buf = s->context->loop->data.recv_buf + LIBUS_RECV_BUFFER_PADDING;
+                    read_length = s->context->loop->data.recv_buf_length;
+                    if (s->context->loop->data.adaptive_read_size && (MIN_ADAPTIVE_READ_LENGTH << s->read_shift) < read_length) {
+                        read_length = MIN_ADAPTIVE_READ_LENGTH << s->read_shift;
+                    }
+                }
+                max_length = read_length;
+                if (quota && quota - total_length < (unsigned int) max_length) {
+                    max_length = (int) (quota - total_length);
+                }
+                length = us_internal_socket_recv(&s, buf, max_length);
+                if (length < 0 && us_socket_is_closed(0, s)) {
+                    return;
+                }
                 if (length > 0) {
-                    s = s->context->on_data(s, s->context->loop->data.recv_buf + LIBUS_RECV_BUFFER_PADDING, length);
+                    total_length += length;
+
+                    /* Grow when a read filled what we asked for, shrink when it used less than a quarter */
+                    if (s->context->loop->data.adaptive_read_size && !app_buffer) {
+                        if (length == read_length && read_length < s->context->loop->data.recv_buf_length) {
+                            s->read_shift++;
+                        } else if (length <= read_length / 4 && s->read_shift) {
+                            s->read_shift--;
+                        }
+                    }
+
+                    US_PROBE2(data, s, length);
+                    US_CALLBACK_BEGIN(timing, s->context);
+                    s = s->context->on_data(s, buf, length);
+                    US_CALLBACK_END(timing, LIBUS_CALLBACK_DATA);
 
                     /* If we filled the entire recv buffer, we need to immediately read again since otherwise a
                      * pending hangup event in the same even loop iteration can close the socket before we get
                      * the chance to read again next iteration */
-                    if (length == LIBUS_RECV_BUFFER_LENGTH && s && !us_socket_is_closed(0, s)) {
-                        goto read_more;
+                    if (length == max_length && s && !us_socket_is_closed(0, s) && !(s->flags & SOCKET_FLAG_PAUSED)) {
+                        if (!quota || total_length < quota) {
+                            goto read_more;
+                        }
+
+                        /* Out of quota, polling is level-triggered so we come back next iteration after the others.
+                         * Should the socket hang up meanwhile, the error path reads what we left first */
+                        s->flags |= SOCKET_FLAG_READ_DEFERRED;
                     }
 
                 } else if (!length) {
@@ -373,8 +675,11 @@ void us_internal_dispatch_ready_poll(struct us_poll_t *p, int error, int events)
                         s = us_socket_close(0, s, 0, NULL);
                     } else {
                         /* We got FIN, so stop polling for readable */
+                        s->flags |= SOCKET_FLAG_RECEIVED_FIN;
                         us_poll_change(&s->p, us_socket_context(0, s)->loop, us_poll_events(&s->p) & LIBUS_SOCKET_WRITABLE);
+                        US_CALLBACK_BEGIN(timing, s->context);
                         s = s->context->on_end(s);
+                        US_CALLBACK_END(timing, LIBUS_CALLBACK_END);
                     }
                 } else if (length == LIBUS_SOCKET_ERROR && !bsd_would_block()) {
                     /* Todo: decide also here what kind of reason we should give */
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+
+/* A piped socket owns one pipe carrying what we read off it towards its peer. Data never
+ * enters user space; when the peer cannot take more we stop reading from the source until
+ * the peer reports writable again, so the kernel socket buffers push back on the sender. */
+
+/* Moves as much as possible of what src has in its pipe into dst. Returns what is left */
+static int us_internal_pipe_flush(struct us_internal_socket_aux_t *src_aux, struct us_socket_t *dst) {
+    while (src_aux->pipe_buffered) {
+        int written = bsd_splice(src_aux->pipe_fds[0], us_poll_fd(&dst->p), src_aux->pipe_buffered);
+        if (written <= 0) {
+            /* Would block, or dst failed in which case its own poll will report the error */
+            break;
+        }
+        src_aux->pipe_buffered -= written;
+    }
+    return src_aux->pipe_buffered;
+}
+
+/* Stops reading src until dst has drained what src already has in its pipe */
+static void us_internal_pipe_throttle(struct us_socket_t *src, struct us_socket_t *dst) {
+    struct us_loop_t *loop = src->context->loop;
+    us_poll_change(&src->p, loop, us_poll_events(&src->p) & LIBUS_SOCKET_WRITABLE);
+    us_poll_change(&dst->p, loop, us_poll_events(&dst->p) | LIBUS_SOCKET_WRITABLE);
+}
+
+static void us_internal_pipe_unthrottle(struct us_socket_t *src, struct us_socket_t *dst) {
+    struct us_loop_t *loop = src->context->loop;
+    if (!us_socket_is_closed(0, src) && !(src->flags & SOCKET_FLAG_PAUSED)) {
+        us_poll_change(&src->p, loop, us_poll_events(&src->p) | LIBUS_SOCKET_READABLE);
+    }
+    if (!us_socket_is_closed(0, dst)) {
+        us_poll_change(&dst->p, loop, us_poll_events(&dst->p) & LIBUS_SOCKET_READABLE);
+    }
+}
+
+/* Takes src out of pipe mode after a last attempt at flushing into dst. Returns the read end
+ * of the pipe if it still holds data, otherwise LIBUS_SOCKET_ERROR */
+static LIBUS_SOCKET_DESCRIPTOR us_internal_pipe_detach(struct us_socket_t *src, struct us_socket_t *dst) {
+    struct us_internal_socket_aux_t *aux = src->aux;
+    LIBUS_SOCKET_DESCRIPTOR leftover_fd = aux->pipe_fds[0];
+
+    if (aux->pipe_buffered) {
+        if (!us_socket_is_closed(0, dst)) {
+            us_internal_pipe_flush(aux, dst);
+        }
+        /* src was throttled while the pipe held data */
+        us_internal_pipe_unthrottle(src, dst);
+    }
+
+    bsd_close_socket(aux->pipe_fds[1]);
+    if (!aux->pipe_buffered) {
+        bsd_close_socket(leftover_fd);
+        leftover_fd = LIBUS_SOCKET_ERROR;
+    }
+
+    aux->pipe_peer = 0;
+    aux->pipe_fds[0] = aux->pipe_fds[1] = LIBUS_SOCKET_ERROR;
+    aux->pipe_buffered = 0;
+
+    return leftover_fd;
+}
+
+/* Hands what was taken off s but never reached its peer back to the app, as if it had just been read */
+static struct us_socket_t *us_internal_pipe_emit(struct us_socket_t *s, LIBUS_SOCKET_DESCRIPTOR fd) {
+    if (fd == LIBUS_SOCKET_ERROR) {
+        return s;
+    }
+
+    char *buf = s->context->loop->data.recv_buf + LIBUS_RECV_BUFFER_PADDING;
+    int length;
+    while (!us_socket_is_closed(0, s) && (length = bsd_pipe_read(fd, buf, s->context->loop->data.recv_buf_length)) > 0) {
+        s = s->context->on_data(s, buf, length);
+    }
+
+    bsd_close_socket(fd);
+    return s;
+}
+
+int us_socket_pipe(int ssl_a, struct us_socket_t *a, int ssl_b, struct us_socket_t *b) {
+    /* Encrypted streams cannot be forwarded as-is */
+    if (ssl_a || ssl_b || a == b) {
+        return 0;
+    }
+
+    if (us_socket_is_closed(0, a) || us_socket_is_closed(0, b) || !us_socket_is_established(0, a) || !us_socket_is_established(0, b)) {
+        return 0;
+    }
+
+    if (us_socket_is_shut_down(0, a) || us_socket_is_shut_down(0, b) || a->context->loop != b->context->loop) {
+        return 0;
+    }
+
+    /* Sockets waiting in the low-priority queue are not polling for readable, let them settle first */
+    if (a->low_prio_state == 1 || b->low_prio_state == 1) {
+        return 0;
+    }
+
+    if ((a->aux && a->aux->pipe_peer) || (b->aux && b->aux->pipe_peer)) {
+        return 0;
+    }
+
+    LIBUS_SOCKET_DESCRIPTOR a_fds[2], b_fds[2];
+    if (bsd_create_pipe(a_fds)) {
+        return 0;
+    }
+    if (bsd_create_pipe(b_fds)) {
+        bsd_close_socket(a_fds[0]);
+        bsd_close_socket(a_fds[1]);
+        return 0;
+    }
+
+    struct us_internal_socket_aux_t *a_aux = us_internal_socket_aux(a);
+    a_aux->pipe_peer = b;
+    a_aux->pipe_fds[0] = a_fds[0];
+    a_aux->pipe_fds[1] = a_fds[1];
+    a_aux->pipe_buffered = 0;
+
+    struct us_internal_socket_aux_t *b_aux = us_internal_socket_aux(b);
+    b_aux->pipe_peer = a;
+    b_aux->pipe_fds[0] = b_fds[0];
+    b_aux->pipe_fds[1] = b_fds[1];
+    b_aux->pipe_buffered = 0;
+
+    return 1;
+}
+
+struct us_socket_t *us_socket_unpipe(int ssl, struct us_socket_t *s) {
+    if (ssl || !s->aux || !s->aux->pipe_peer) {
+        return s;
+    }
+
+    /* Detach both directions before emitting anything so that callbacks see both sockets in callback mode */
+    struct us_socket_t *peer = s->aux->pipe_peer;
+    LIBUS_SOCKET_DESCRIPTOR s_leftover = us_internal_pipe_detach(s, peer);
+    LIBUS_SOCKET_DESCRIPTOR peer_leftover = us_internal_pipe_detach(peer, s);
+
+    /* Note: the peer must not be adopted (moved) from within the on_data emitted for s and vice versa */
+    us_internal_pipe_emit(peer, peer_leftover);
+    return us_internal_pipe_emit(s, s_leftover);
+}
+
+/* Called by us_socket_close once s is marked closed. What s already read is flushed to the peer
+ * as far as it can take it without blocking, what was headed for s is dropped along with s */
+void us_internal_socket_pipe_close(struct us_socket_t *s) {
+    struct us_socket_t *peer = s->aux->pipe_peer;
+    LIBUS_SOCKET_DESCRIPTOR s_leftover = us_internal_pipe_detach(s, peer);
+    LIBUS_SOCKET_DESCRIPTOR peer_leftover = us_internal_pipe_detach(peer, s);
+
+    if (s_leftover != LIBUS_SOCKET_ERROR) {
+        bsd_close_socket(s_leftover);
+    }
+    if (peer_leftover != LIBUS_SOCKET_ERROR) {
+        bsd_close_socket(peer_leftover);
+    }
+}
+
+/* Called on hangup before s is closed. Forwards what the peer can take without blocking, anything still
+ * queued is then handed to the app as on_data just like us_socket_unpipe does */
+struct us_socket_t *us_internal_socket_pipe_hangup(struct us_socket_t *s) {
+    struct us_internal_socket_aux_t *aux = s->aux;
+
+    while (!us_internal_pipe_flush(aux, aux->pipe_peer)) {
+        int length = bsd_splice(us_poll_fd(&s->p), aux->pipe_fds[1], LIBUS_RECV_BUFFER_LENGTH);
+        if (length <= 0) {
+            break;
+        }
+        aux->pipe_buffered = length;
+    }
+
+    s = us_socket_unpipe(0, s);
+
+    char *buf = s->context->loop->data.recv_buf + LIBUS_RECV_BUFFER_PADDING;
+    int length;
+    while (!us_socket_is_closed(0, s) && (length = bsd_recv(us_poll_fd(&s->p), buf, s->context->loop->data.recv_buf_length, 0)) > 0) {
+        s = s->context->on_data(s, buf, length);
+    }
+
+    return s;
+}
+
+/* Returns null if the event was fully handled, or the socket if it got FIN which the regular
+ * read path should handle (it will see the FIN again) */
+struct us_socket_t *us_internal_socket_pipe_dispatch(struct us_socket_t *s, int events) {
+    struct us_internal_socket_aux_t *aux = s->aux;
+    struct us_socket_t *peer = aux->pipe_peer;
+
+    /* Writable means we can drain what the peer has queued up towards us */
+    if (events & LIBUS_SOCKET_WRITABLE) {
+        if (!peer->aux->pipe_buffered) {
+            us_poll_change(&s->p, s->context->loop, us_poll_events(&s->p) & LIBUS_SOCKET_READABLE);
+        } else if (!us_internal_pipe_flush(peer->aux, s)) {
+            us_internal_pipe_unthrottle(peer, s);
+        }
+    }
+
+    if (events & LIBUS_SOCKET_READABLE) {
+        unsigned int quota = s->context->loop->data.read_quota, total_length = 0;
+
+        /* We may have been throttled by the flush above not completing */
+        while (!aux->pipe_buffered) {
+            int length = bsd_splice(us_poll_fd(&s->p), aux->pipe_fds[1], LIBUS_RECV_BUFFER_LENGTH);
+            if (length > 0) {
+                aux->pipe_buffered = length;
+                if (us_internal_pipe_flush(aux, peer)) {
+                    us_internal_pipe_throttle(s, peer);
+                }
+
+                /* Hangups are handled by us_internal_socket_pipe_hangup so we can simply come back next iteration */
+                total_length += length;
+                if (quota && total_length >= quota) {
+                    break;
+                }
+            } else if (!length) {
+                /* Splice can also come back empty while data is queued, only an empty peek means FIN */
+                char peek;
+                if (bsd_recv(us_poll_fd(&s->p), &peek, 1, MSG_PEEK) != 0) {
+                    break;
+                }
+
+                /* Our pipe is empty so everything before the FIN reached the peer. Let the regular read path
+                 * emit on_end (or close if we already shut down), the other direction stays piped */
+                return s;
+            } else {
+                if (!bsd_would_block()) {
+                    us_socket_close(0, s, 0, NULL);
+                }
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Idle connections wait in a child context of their own, whose callbacks close them on anything but silence.
+ * Handing one out or taking it back is adopting it between the contexts, at the same size it had, so reuse
+ * touches no syscalls. */
+
+#define POOL_BUCKETS 64
+#define POOL_DEFAULT_MAX_IDLE 8
+
+/* Connections to one host and port, keyed by name as connected to */
+struct us_internal_pool_host_t {
+    struct us_internal_pool_host_t *next;
+    struct us_internal_pool_t *pool;
+    char *host;
+    int port;
+    /* Most recently released first, linked through aux */
+    struct us_socket_t *idle_head;
+    int idle;
+    /* Idle, in use and connecting */
+    int total;
+};
+
+struct us_internal_pool_t {
+    struct us_pool_options_t options;
+    int ssl;
+    struct us_socket_context_t *idle_context;
+    struct us_internal_pool_host_t *buckets[POOL_BUCKETS];
+};
+
+static struct us_internal_pool_host_t **us_internal_pool_find(struct us_internal_pool_t *pool, const char *host, int port) {
+    /* FNV-1a */
+    unsigned int hash = 2166136261u ^ (unsigned int) port;
+    for (const char *c = host; *c; c++) {
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    }
+
+    struct us_internal_pool_host_t **link = &pool->buckets[hash % POOL_BUCKETS];
+    while (*link && ((*link)->port != port || strcmp((*link)->host, host))) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void us_internal_pool_unlink_idle(struct us_internal_pool_host_t *host, struct us_socket_t *s) {
+    struct us_internal_socket_aux_t *aux = s->aux;
+    if (aux->pool_prev) {
+        aux->pool_prev->aux->pool_next = aux->pool_next;
+    } else {
+        host->idle_head = aux->pool_next;
+    }
+    if (aux->pool_next) {
+        aux->pool_next->aux->pool_prev = aux->pool_prev;
+    }
+    aux->pool_prev = aux->pool_next = 0;
+    s->flags &= ~SOCKET_FLAG_POOL_IDLE;
+    host->idle--;
+}
+
+/* Called when a socket of the pool closes, idle or not */
+void us_internal_pool_forget(struct us_socket_t *s) {
+    struct us_internal_pool_host_t *host = s->aux->pool_host;
+    s->aux->pool_host = 0;
+    if (s->flags & SOCKET_FLAG_POOL_IDLE) {
+        us_internal_pool_unlink_idle(host, s);
+    }
+
+    if (!--host->total) {
+        struct us_internal_pool_host_t **link = us_internal_pool_find(host->pool, host->host, host->port);
+        *link = host->next;
+        free(host->host);
+        free(host);
+    }
+}
+
+/* Servers do not speak on idle connections, whatever they do means the connection is done */
+static struct us_socket_t *us_internal_pool_on_data(struct us_socket_t *s, char *data, int length) {
+    return us_socket_close(s->aux->pool_host->pool->ssl, s, 0, NULL);
+}
+
+static struct us_socket_t *us_internal_pool_on_end(struct us_socket_t *s) {
+    return us_socket_close(s->aux->pool_host->pool->ssl, s, 0, NULL);
+}
+
+static struct us_socket_t *us_internal_pool_on_timeout(struct us_socket_t *s) {
+    return us_socket_close(s->aux->pool_host->pool->ssl, s, 0, NULL);
+}
+
+static struct us_socket_t *us_internal_pool_on_writable(struct us_socket_t *s) {
+    return s;
+}
+
+static struct us_socket_t *us_internal_pool_on_close(struct us_socket_t *s, int code, void *reason) {
+    return s;
+}
+
+void us_socket_context_pool(int ssl, struct us_socket_context_t *context, struct us_pool_options_t options) {
+    if (!options.max_idle) {
+        options.max_idle = POOL_DEFAULT_MAX_IDLE;
+    }
+
+    if (context->pool) {
+        context->pool->options = options;
+        return;
+    }
+
+    struct us_internal_pool_t *pool = calloc(1, sizeof(struct us_internal_pool_t));
+    if (!pool) {
+        return;
+    }
+    pool->options = options;
+    pool->ssl = ssl;
+    pool->idle_context = us_create_child_socket_context(ssl, context, 0);
+    if (!pool->idle_context) {
+        free(pool);
+        return;
+    }
+
+    us_socket_context_on_data(ssl, pool->idle_context, us_internal_pool_on_data);
+    us_socket_context_on_end(ssl, pool->idle_context, us_internal_pool_on_end);
+    us_socket_context_on_timeout(ssl, pool->idle_context, us_internal_pool_on_timeout);
+    us_socket_context_on_writable(ssl, pool->idle_context, us_internal_pool_on_writable);
+    us_socket_context_on_close(ssl, pool->idle_context, us_internal_pool_on_close);
+    context->pool = pool;
+}
+
+struct us_socket_t *us_pool_acquire(int ssl, struct us_socket_context_t *context, const char *host, int port, int options,
+    int socket_ext_size, int *reused) {
+    struct us_internal_pool_t *pool = context->pool;
+    *reused = 0;
+    if (!pool) {
+        return us_socket_context_connect(ssl, context, host, port, NULL, options, socket_ext_size);
+    }
+
+    struct us_internal_pool_host_t **link = us_internal_pool_find(pool, host, port);
+    struct us_internal_pool_host_t *pool_host = *link;
+
+    if (pool_host && pool_host->idle_head) {
+        struct us_socket_t *s = pool_host->idle_head;
+        us_internal_pool_unlink_idle(pool_host, s);
+
+        /* Sockets keep their size when released, so asking for the same size again moves nothing */
+        s->aux->pool_ext_size = socket_ext_size;
+        *reused = 1;
+        return us_socket_context_adopt_socket(ssl, context, s, socket_ext_size);
+    }
+
+    if (pool_host && pool->options.max_total && pool_host->total >= pool->options.max_total) {
+        return 0;
+    }
+
+    if (!pool_host) {
+        pool_host = calloc(1, sizeof(struct us_internal_pool_host_t));
+        if (!pool_host || !(pool_host->host = strdup(host))) {
+            free(pool_host);
+            return 0;
+        }
+        pool_host->pool = pool;
+        pool_host->port = port;
+    }
+
+    struct us_socket_t *s = us_socket_context_connect(ssl, context, host, port, NULL, options, socket_ext_size);
+    struct us_internal_socket_aux_t *aux = s ? us_internal_socket_aux(s) : 0;
+    if (!aux) {
+        /* Unpooled but usable all the same */
+        if (!pool_host->total) {
+            free(pool_host->host);
+            free(pool_host);
+        }
+        return s;
+    }
+
+    if (!pool_host->total) {
+        pool_host->next = 0;
+        *link = pool_host;
+    }
+    aux->pool_host = pool_host;
+    aux->pool_ext_size = socket_ext_size;
+    pool_host->total++;
+    return s;
+}
+
+struct us_socket_t *us_pool_release(int ssl, struct us_socket_t *s) {
+    if (us_socket_is_closed(ssl, s)) {
+        return s;
+    }
+
+    if (!us_socket_is_established(ssl, s)) {
+        return us_socket_close_connecting(ssl, s);
+    }
+
+    struct us_internal_pool_host_t *host = s->aux ? s->aux->pool_host : 0;
+    if (!host || us_socket_is_shut_down(ssl, s) || host->idle >= host->pool->options.max_idle) {
+        return us_socket_close(ssl, s, 0, NULL);
+    }
+
+    struct us_internal_pool_t *pool = host->pool;
+    s = us_socket_context_adopt_socket(ssl, pool->idle_context, s, s->aux->pool_ext_size);
+    us_socket_timeout(ssl, s, pool->options.idle_timeout);
+
+    struct us_internal_socket_aux_t *aux = s->aux;
+    aux->pool_prev = 0;
+    aux->pool_next = host->idle_head;
+    if (host->idle_head) {
+        host->idle_head->aux->pool_prev = s;
+    }
+    host->idle_head = s;
+    host->idle++;
+    s->flags |= SOCKET_FLAG_POOL_IDLE;
+    return s;
+}
+
+/* Idle connections go with the context they were acquired from */
+void us_internal_pool_close(struct us_socket_context_t *context) {
+    us_socket_context_close(context->pool->ssl, context->pool->idle_context);
+}
+
+void us_internal_pool_free(struct us_socket_context_t *context) {
+    struct us_internal_pool_t *pool = context->pool;
+    context->pool = 0;
+
+    /* Sockets still in use stop counting against the pool */
+    for (struct us_socket_t *s = context->head_sockets; s; s = s->next) {
+        if (s->aux && s->aux->pool_host && s->aux->pool_host->pool == pool) {
+            s->aux->pool_host = 0;
+        }
+    }
+    for (int i = 0; i < POOL_BUCKETS; i++) {
+        while (pool->buckets[i]) {
+            struct us_internal_pool_host_t *host = pool->buckets[i];
+            pool->buckets[i] = host->next;
+            free(host->host);
+            free(host);
+        }
+    }
+    us_socket_context_free(pool->ssl, pool->idle_context);
+    free(pool);
+}
+
+#endif
@@ -58,6 +58,13 @@ void us_socket_remote_address(int ssl, struct us_socket_t *s, char *buf, int *le
     }
 }
 
+int us_socket_tcp_info(int ssl, struct us_socket_t *s, struct us_tcp_info_t *info) {
+    if (us_socket_is_closed(ssl, s) || (s->flags & SOCKET_FLAG_RESOLVING)) {
+        return 0;
+    }
+    return bsd_socket_tcp_info(us_poll_fd(&s->p), info);
+}
+
 struct us_socket_context_t *us_socket_context(int ssl, struct us_socket_t *s) {
     return s->context;
 }
@@ -93,12 +100,95 @@ int us_socket_is_established(int ssl, struct us_socket_t *s) {
     return us_internal_poll_type((struct us_poll_t *) s) != POLL_TYPE_SEMI_SOCKET;
 }
 
+void us_socket_pause(int ssl, struct us_socket_t *s) {
+    if (us_socket_is_closed(0, s) || (s->flags & SOCKET_FLAG_PAUSED)) {
+        return;
+    }
+
+    s->flags |= SOCKET_FLAG_PAUSED;
+
+    /* Sockets in the low-priority queue already stopped polling for readable and will not start again while paused */
+    if (s->low_prio_state != 1) {
+        us_poll_change(&s->p, s->context->loop, us_poll_events(&s->p) & LIBUS_SOCKET_WRITABLE);
+    }
+}
+
+void us_socket_resume(int ssl, struct us_socket_t *s) {
+    if (us_socket_is_closed(0, s) || !(s->flags & SOCKET_FLAG_PAUSED)) {
+        return;
+    }
+
+    s->flags &= ~SOCKET_FLAG_PAUSED;
+
+    /* Connecting sockets start polling for readable once connected, low-priority ones once dequeued */
+    if (!us_socket_is_established(0, s)) {
+        return;
+    }
+
+    /* There is nothing more to read after FIN, and a throttled pipe resumes reading once drained */
+    if (s->low_prio_state != 1 && !(s->flags & SOCKET_FLAG_RECEIVED_FIN) && !(s->aux && s->aux->pipe_peer && s->aux->pipe_buffered)) {
+        us_poll_change(&s->p, s->context->loop, us_poll_events(&s->p) | LIBUS_SOCKET_READABLE);
+    }
+
+#ifndef LIBUS_NO_SSL
+    if (ssl) {
+        us_internal_ssl_socket_resume((struct us_internal_ssl_socket_t *) s);
+    }
+#endif
+}
+
+int us_socket_is_paused(int ssl, struct us_socket_t *s) {
+    return s->flags & SOCKET_FLAG_PAUSED;
+}
+
+int us_socket_set_read_buffer(int ssl, struct us_socket_t *s, char *buffer, int length) {
+    if (ssl) {
+        return 0;
+    }
+
+    if (!buffer || length <= 0) {
+        if (s->aux) {
+            s->aux->read_buffer = 0;
+            s->aux->read_buffer_length = 0;
+        }
+        return 1;
+    }
+
+    struct us_internal_socket_aux_t *aux = us_internal_socket_aux(s);
+    if (!aux) {
+        return 0;
+    }
+    aux->read_buffer = buffer;
+    aux->read_buffer_length = length;
+    return 1;
+}
+
+struct us_internal_socket_aux_t *us_internal_socket_aux(struct us_socket_t *s) {
+    if (!s->aux) {
+        s->aux = calloc(1, sizeof(struct us_internal_socket_aux_t));
+    }
+    return s->aux;
+}
+
 /* Exactly the same as us_socket_close but does not emit on_close event */
 struct us_socket_t *us_socket_close_connecting(int ssl, struct us_socket_t *s) {
     if (!us_socket_is_closed(0, s)) {
         us_internal_socket_context_unlink_socket(s->context, s);
-        us_poll_stop((struct us_poll_t *) s, s->context->loop);
-        bsd_close_socket(us_poll_fd((struct us_poll_t *) s));
+        if (s->flags & SOCKET_FLAG_RESOLVING) {
+            /* Nothing is polled or opened before the host name resolves */
+            us_internal_socket_resolve_cancel(s);
+        } else {
+            us_poll_stop((struct us_poll_t *) s, s->context->loop);
+            bsd_close_socket(us_poll_fd((struct us_poll_t *) s));
+        }
+#ifdef LIBUS_USE_HAPPY_EYEBALLS
+        if (s->aux && s->aux->connect_race) {
+            us_internal_connect_race_cancel(s);
+        }
+#endif
+        if (s->aux && s->aux->pool_host) {
+            us_internal_pool_forget(s);
+        }
 
         /* Link this socket to the close-list and let it be deleted after this iteration */
         s->next = s->context->loop->data.closed_head;
@@ -106,6 +196,7 @@ struct us_socket_t *us_socket_close_connecting(int ssl, struct us_socket_t *s) {
 
         /* Any socket with prev = context is marked as closed */
         s->prev = (struct us_socket_t *) s->context;
+        US_METRIC_ADD(s->context->loop, sockets, -1);
 
         //return s->context->on_close(s, code, reason);
     }
@@ -125,11 +216,28 @@ struct us_socket_t *us_socket_close(int ssl, struct us_socket_t *s, int code, vo
             s->prev = 0;
             s->next = 0;
             s->low_prio_state = 0;
+            US_METRIC_ADD(s->context->loop, low_prio_queued, -1);
+            us_internal_socket_context_count(s->context, s, -1);
         } else {
             us_internal_socket_context_unlink_socket(s->context, s);
         }
-        us_poll_stop((struct us_poll_t *) s, s->context->loop);
-        bsd_close_socket(us_poll_fd((struct us_poll_t *) s));
+        if (s->flags & SOCKET_FLAG_RESOLVING) {
+            us_internal_socket_resolve_cancel(s);
+        } else {
+            us_poll_stop((struct us_poll_t *) s, s->context->loop);
+            bsd_close_socket(us_poll_fd((struct us_poll_t *) s));
+        }
+#ifdef LIBUS_USE_HAPPY_EYEBALLS
+        if (s->aux && s->aux->connect_race) {
+            us_internal_connect_race_cancel(s);
+        }
+#endif
+        if (s->aux && s->aux->pool_host) {
+            us_internal_pool_forget(s);
+        }
+        if (s->flags & SOCKET_FLAG_IP_COUNTED) {
+            us_internal_ip_limiter_release(s->context->loop, s->source);
+        }
 
         /* Link this socket to the close-list and let it be deleted after this iteration */
         s->next = s->context->loop->data.closed_head;
@@ -137,6 +245,14 @@ struct us_socket_t *us_socket_close(int ssl, struct us_socket_t *s, int code, vo
 
         /* Any socket with prev = context is marked as closed */
         s->prev = (struct us_socket_t *) s->context;
+        US_METRIC_ADD(s->context->loop, closes, 1);
+        US_METRIC_ADD(s->context->loop, sockets, -1);
+        US_PROBE2(close, s, code);
+
+        /* The pipe peer silently goes back to callback mode */
+        if (s->aux && s->aux->pipe_peer) {
+            us_internal_socket_pipe_close(s);
+        }
 
         return s->context->on_close(s, code, reason);
     }
@@ -163,8 +279,32 @@ int us_socket_write2(int ssl, struct us_socket_t *s, const char *header, int hea
     }
 
     int written = bsd_write2(us_poll_fd(&s->p), header, header_length, payload, payload_length);
+    US_PROBE3(write, s, header_length + payload_length, written);
+    US_METRIC_ADD(s->context->loop, send_calls, 1);
+    US_METRIC_ADD(s->context->loop, send_bytes, written > 0 ? written : 0);
     if (written != header_length + payload_length) {
-        us_poll_change(&s->p, s->context->loop, LIBUS_SOCKET_READABLE | LIBUS_SOCKET_WRITABLE);
+        US_METRIC_ADD(s->context->loop, partial_writes, 1);
+        /* Keep whatever readable state we are in (paused, throttled, low-priority, got FIN) */
+        us_poll_change(&s->p, s->context->loop, us_poll_events(&s->p) | LIBUS_SOCKET_WRITABLE);
+    }
+
+    return written < 0 ? 0 : written;
+}
+
+int us_socket_write_fds(int ssl, struct us_socket_t *s, const char *data, int length, LIBUS_SOCKET_DESCRIPTOR *fds, int num_fds) {
+    if (ssl || us_socket_is_closed(ssl, s) || us_socket_is_shut_down(ssl, s) || num_fds > LIBUS_MAX_PASSED_FDS || length <= 0) {
+        return 0;
+    }
+
+    int written = bsd_send_fds(us_poll_fd(&s->p), data, length, fds, num_fds);
+    US_PROBE3(write, s, length, written);
+    US_METRIC_ADD(s->context->loop, send_calls, 1);
+    US_METRIC_ADD(s->context->loop, send_bytes, written > 0 ? written : 0);
+    if (written != length) {
+        US_METRIC_ADD(s->context->loop, partial_writes, 1);
+        s->context->loop->data.last_write_failed = 1;
+        /* Keep whatever readable state we are in (paused, throttled, low-priority, got FIN) */
+        us_poll_change(&s->p, s->context->loop, us_poll_events(&s->p) | LIBUS_SOCKET_WRITABLE);
     }
 
     return written < 0 ? 0 : written;
@@ -182,9 +322,14 @@ int us_socket_write(int ssl, struct us_socket_t *s, const char *data, int length
     }
 
     int written = bsd_send(us_poll_fd(&s->p), data, length, msg_more);
+    US_PROBE3(write, s, length, written);
+    US_METRIC_ADD(s->context->loop, send_calls, 1);
+    US_METRIC_ADD(s->context->loop, send_bytes, written > 0 ? written : 0);
     if (written != length) {
+        US_METRIC_ADD(s->context->loop, partial_writes, 1);
         s->context->loop->data.last_write_failed = 1;
-        us_poll_change(&s->p, s->context->loop, LIBUS_SOCKET_READABLE | LIBUS_SOCKET_WRITABLE);
+        /* Keep whatever readable state we are in (paused, throttled, low-priority, got FIN) */
+        us_poll_change(&s->p, s->context->loop, us_poll_events(&s->p) | LIBUS_SOCKET_WRITABLE);
     }
 
     return written < 0 ? 0 : written;
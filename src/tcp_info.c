@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* The timeout sweep walks the sockets of a context anyway, sampling takes every one_in-th of them along, starting
+ * one further each sweep so that over one_in sweeps every socket was sampled once */
+struct us_internal_tcp_sampler_t {
+    unsigned int one_in;
+    unsigned int offset;
+    struct us_histogram_t histograms[LIBUS_TCP_INFO_TYPES];
+};
+
+void us_internal_tcp_info_sample(struct us_socket_context_t *context) {
+    struct us_internal_tcp_sampler_t *sampler = context->tcp_sampler;
+    if (!sampler->one_in) {
+        return;
+    }
+    sampler->offset = (sampler->offset + 1) % sampler->one_in;
+
+    unsigned int skip = sampler->offset;
+    for (struct us_socket_t *s = context->head_sockets; s; s = s->next) {
+        if (skip) {
+            skip--;
+            continue;
+        }
+        skip = sampler->one_in - 1;
+
+        /* Still connecting or resolving has nothing to tell */
+        struct us_tcp_info_t info;
+        if (us_internal_poll_type(&s->p) == POLL_TYPE_SEMI_SOCKET || !us_socket_tcp_info(0, s, &info)) {
+            continue;
+        }
+        us_internal_histogram_record(&sampler->histograms[LIBUS_TCP_INFO_RTT_US], info.rtt_us);
+        us_internal_histogram_record(&sampler->histograms[LIBUS_TCP_INFO_CWND], info.cwnd);
+        us_internal_histogram_record(&sampler->histograms[LIBUS_TCP_INFO_RETRANSMITS], info.total_retransmits);
+        us_internal_histogram_record(&sampler->histograms[LIBUS_TCP_INFO_UNACKED_BYTES], info.unacked_bytes);
+    }
+}
+
+void us_socket_context_sample_tcp_info(int ssl, struct us_socket_context_t *context, unsigned int one_in) {
+    if (!context->tcp_sampler) {
+        if (!one_in) {
+            return;
+        }
+        struct us_internal_tcp_sampler_t *sampler = calloc(1, sizeof(struct us_internal_tcp_sampler_t));
+        if (!sampler) {
+            return;
+        }
+        US_PUBLISH(context->tcp_sampler, sampler);
+    }
+    context->tcp_sampler->one_in = one_in;
+    context->tcp_sampler->offset = 0;
+}
+
+int us_socket_context_tcp_info_histogram(int ssl, struct us_socket_context_t *context, int type, struct us_histogram_t *histogram) {
+    memset(histogram, 0, sizeof(struct us_histogram_t));
+    struct us_internal_tcp_sampler_t *sampler = US_ACQUIRE(context->tcp_sampler);
+    if (type < 0 || type >= LIBUS_TCP_INFO_TYPES || !sampler) {
+        return 0;
+    }
+    us_internal_histogram_copy(histogram, &sampler->histograms[type]);
+    return histogram->count != 0;
+}
+
+#endif
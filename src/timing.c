@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026 Marek Zalewski aka Drwalin
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *     http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBUS_USE_IO_URING
+
+#include "libusockets.h"
+#include "internal/internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LIBUS_USE_CALLBACK_TIMING
+void us_internal_callback_record(struct us_socket_context_t *context, int type, long long started_ns) {
+    long long elapsed_us = (us_internal_now_ns() - started_ns) / 1000;
+    unsigned int us = elapsed_us > 0xFFFFFFFFLL ? 0xFFFFFFFF : (unsigned int) elapsed_us;
+
+    /* Published once allocated, for the histograms to be read from other threads */
+    if (!context->callback_timing) {
+        struct us_histogram_t *histograms = calloc(LIBUS_CALLBACK_TYPES, sizeof(struct us_histogram_t));
+        if (!histograms) {
+            return;
+        }
+        US_PUBLISH(context->callback_timing, histograms);
+    }
+    us_internal_histogram_record(&context->callback_timing[type], us);
+
+    struct us_loop_t *loop = context->loop;
+    if (loop->data.on_slow_callback && us >= loop->data.slow_callback_us) {
+        loop->data.on_slow_callback(context, type, us);
+    }
+}
+#endif
+
+int us_socket_context_callback_histogram(int ssl, struct us_socket_context_t *context, int type, struct us_histogram_t *histogram) {
+    memset(histogram, 0, sizeof(struct us_histogram_t));
+#ifdef LIBUS_USE_CALLBACK_TIMING
+    struct us_histogram_t *histograms = US_ACQUIRE(context->callback_timing);
+    if (type < 0 || type >= LIBUS_CALLBACK_TYPES || !histograms) {
+        return 0;
+    }
+    us_internal_histogram_copy(histogram, &histograms[type]);
+    return histogram->count != 0;
+#else
+    return 0;
+#endif
+}
+
+void us_loop_on_slow_callback(struct us_loop_t *loop, unsigned int threshold_us,
+    void (*handler)(struct us_socket_context_t *context, int type, unsigned int elapsed_us)) {
+#ifdef LIBUS_USE_CALLBACK_TIMING
+    loop->data.slow_callback_us = threshold_us;
+    loop->data.on_slow_callback = handler;
+#endif
+}
+
+#endif
@@ -0,0 +1,206 @@
+/* Framing of every length format, with a stream of two frames cut in two at every byte offset. Each piece is
+ * only written once the loop read the one before, so on_data sees the stream cut exactly there: mid header,
+ * mid payload or between frames. Then an over-long varint, whole and byte by byte, and a length that would wrap
+ * around with the header added to it, both of which must close the socket.
+ * gcc -fsanitize=address -g -Isrc tests/frame_test.c uSockets.a -ldl -o frame_test */
+
+#include <libusockets.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_STREAM_LENGTH 1024
+#define MAX_PIECES 1024
+
+/* The stream and how it is cut up */
+unsigned char stream[MAX_STREAM_LENGTH];
+int stream_length;
+int cuts[MAX_PIECES + 1];
+int num_pieces, next_piece;
+int peer, fd;
+
+/* The frames expected, as offsets into stream */
+int frame_offsets[3];
+int header_length, num_frames, received, closed;
+unsigned int max_payload_length;
+
+void on_wakeup(struct us_loop_t *loop) {}
+void on_pre(struct us_loop_t *loop) {}
+
+/* Writes the next piece once the loop has read everything before it */
+void on_post(struct us_loop_t *loop) {
+	int unread;
+	if (closed || next_piece == num_pieces || ioctl(fd, FIONREAD, &unread) || unread) {
+		return;
+	}
+	int length = cuts[next_piece + 1] - cuts[next_piece];
+	assert(write(peer, stream + cuts[next_piece], length) == length);
+	next_piece++;
+}
+
+struct us_socket_t *on_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+	return s;
+}
+
+struct us_socket_t *on_message(struct us_socket_t *s, char *header, int length_of_header, char *payload, int length) {
+	assert(received < num_frames);
+	unsigned char *frame = stream + frame_offsets[received];
+	int frame_length = frame_offsets[received + 1] - frame_offsets[received];
+	assert(length_of_header == header_length);
+	assert(length_of_header + length == frame_length);
+	assert(!memcmp(header, frame, length_of_header));
+	assert(!memcmp(payload, frame + length_of_header, length));
+
+	if (++received == num_frames) {
+		return us_socket_close(0, s, 0, NULL);
+	}
+	return s;
+}
+
+struct us_socket_t *on_writable(struct us_socket_t *s) {
+	return s;
+}
+
+struct us_socket_t *on_close(struct us_socket_t *s, int code, void *reason) {
+	closed = 1;
+	return s;
+}
+
+struct us_socket_t *on_end(struct us_socket_t *s) {
+	return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_timeout(struct us_socket_t *s) {
+	return s;
+}
+
+/* Appends a frame with a message type byte ahead of the length field */
+void append_frame(int length_format, int payload_length) {
+	frame_offsets[num_frames++] = stream_length;
+	stream[stream_length++] = 0x42;
+
+	switch (length_format) {
+	case LIBUS_FRAME_LENGTH_U16:
+		stream[stream_length++] = payload_length >> 8;
+		stream[stream_length++] = payload_length;
+		header_length = 3;
+		break;
+	case LIBUS_FRAME_LENGTH_U32:
+		stream[stream_length++] = payload_length >> 24;
+		stream[stream_length++] = payload_length >> 16;
+		stream[stream_length++] = payload_length >> 8;
+		stream[stream_length++] = payload_length;
+		header_length = 5;
+		break;
+	case LIBUS_FRAME_LENGTH_VARINT:
+		/* Both frames need the same header length, two bytes */
+		assert(payload_length >= 128 && payload_length < 16384);
+		stream[stream_length++] = 0x80 | (payload_length & 0x7f);
+		stream[stream_length++] = payload_length >> 7;
+		header_length = 3;
+		break;
+	}
+
+	for (int i = 0; i < payload_length; i++) {
+		stream[stream_length++] = i * 7 + num_frames;
+	}
+	frame_offsets[num_frames] = stream_length;
+}
+
+/* Feeds the stream in pieces through a framing socket until the socket closes, returns how many frames came out */
+int feed(int length_format) {
+	struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+
+	struct us_socket_context_options_t options = {};
+	struct us_socket_context_t *context = us_create_socket_context(0, loop, 0, options);
+	us_socket_context_on_open(0, context, on_open);
+	us_socket_context_on_writable(0, context, on_writable);
+	us_socket_context_on_close(0, context, on_close);
+	us_socket_context_on_end(0, context, on_end);
+	us_socket_context_on_timeout(0, context, on_timeout);
+
+	struct us_frame_options_t frame_options = {.length_format = length_format, .length_offset = 1, .max_payload_length = max_payload_length};
+	us_socket_context_frame(0, context, frame_options, on_message);
+
+	int fds[2];
+	assert(!socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	fd = fds[0];
+	peer = fds[1];
+	assert(us_adopt_accepted_socket(0, context, fd, 0, "", 0));
+
+	received = closed = 0;
+	next_piece = 0;
+	on_post(loop);
+	us_loop_run(loop);
+	assert(closed);
+
+	us_socket_context_free(0, context);
+	us_loop_free(loop);
+	close(peer);
+	return received;
+}
+
+void frames(int length_format) {
+	stream_length = num_frames = 0;
+	append_frame(length_format, 200);
+	append_frame(length_format, 300);
+
+	for (int cut = 1; cut < stream_length; cut++) {
+		cuts[0] = 0;
+		cuts[1] = cut;
+		cuts[2] = stream_length;
+		num_pieces = 2;
+		assert(feed(length_format) == 2);
+	}
+}
+
+void over_long_varint() {
+	stream_length = num_frames = 0;
+	stream[stream_length++] = 0x42;
+	for (int i = 0; i < 6; i++) {
+		stream[stream_length++] = 0x80;
+	}
+	stream[stream_length++] = 0x01;
+
+	/* Whole, then byte by byte */
+	cuts[0] = 0;
+	cuts[1] = stream_length;
+	num_pieces = 1;
+	assert(feed(LIBUS_FRAME_LENGTH_VARINT) == 0);
+
+	for (int i = 0; i <= stream_length; i++) {
+		cuts[i] = i;
+	}
+	num_pieces = stream_length;
+	assert(feed(LIBUS_FRAME_LENGTH_VARINT) == 0);
+}
+
+void wrapping_length() {
+	stream_length = num_frames = 0;
+	stream[stream_length++] = 0x42;
+	for (int i = 0; i < 4; i++) {
+		stream[stream_length++] = 0xff;
+	}
+
+	cuts[0] = 0;
+	cuts[1] = stream_length;
+	num_pieces = 1;
+	max_payload_length = 0xffffffff;
+	assert(feed(LIBUS_FRAME_LENGTH_U32) == 0);
+	max_payload_length = 0;
+}
+
+int main() {
+	frames(LIBUS_FRAME_LENGTH_U16);
+	frames(LIBUS_FRAME_LENGTH_U32);
+	frames(LIBUS_FRAME_LENGTH_VARINT);
+	over_long_varint();
+	wrapping_length();
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,187 @@
+/* Happy Eyeballs where a later attempt wins the race. race.test resolves to 127.0.0.2 first, whose backlog is full
+ * so its attempt never connects, then 127.0.0.1, which does once the next attempt starts. The winning socket has
+ * to come out of the race a proper socket, echoing data. With Fast Open asked for too, which must not let the first
+ * attempt win before its handshake.
+ * gcc -fsanitize=address -g -Isrc tests/happy_eyeballs_test.c uSockets.a -ldl -o happy_eyeballs_test */
+
+#define _GNU_SOURCE
+#include <libusockets.h>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <dlfcn.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int port;
+int opened, echoed, failed;
+struct us_listen_socket_t *listen_socket;
+struct us_timer_t *deadline;
+
+/* Chains what the real resolver returns for both addresses, which freeaddrinfo frees like one list */
+int getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
+	int (*real)(const char *, const char *, const struct addrinfo *, struct addrinfo **) = dlsym(RTLD_NEXT, "getaddrinfo");
+	if (!node || strcmp(node, "race.test")) {
+		return real(node, service, hints, res);
+	}
+	if (hints && (hints->ai_flags & AI_NUMERICHOST)) {
+		return EAI_NONAME;
+	}
+
+	struct addrinfo *first, *second;
+	if (real("127.0.0.2", service, hints, &first)) {
+		return EAI_FAIL;
+	}
+	if (real("127.0.0.1", service, hints, &second)) {
+		freeaddrinfo(first);
+		return EAI_FAIL;
+	}
+	struct addrinfo *last = first;
+	while (last->ai_next) {
+		last = last->ai_next;
+	}
+	last->ai_next = second;
+	*res = first;
+	return 0;
+}
+
+void on_wakeup(struct us_loop_t *loop) {}
+void on_pre(struct us_loop_t *loop) {}
+void on_post(struct us_loop_t *loop) {}
+
+struct us_socket_t *on_writable(struct us_socket_t *s) {
+	return s;
+}
+
+struct us_socket_t *on_close(struct us_socket_t *s, int code, void *reason) {
+	return s;
+}
+
+struct us_socket_t *on_end(struct us_socket_t *s) {
+	return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_timeout(struct us_socket_t *s) {
+	return s;
+}
+
+struct us_socket_t *on_server_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+	return s;
+}
+
+struct us_socket_t *on_server_data(struct us_socket_t *s, char *data, int length) {
+	us_socket_write(0, s, data, length, 0);
+	return s;
+}
+
+struct us_socket_t *on_client_open(struct us_socket_t *s, int is_client, char *ip, int ip_length) {
+	opened++;
+	us_socket_write(0, s, "ping", 4, 0);
+	return s;
+}
+
+struct us_socket_t *on_client_data(struct us_socket_t *s, char *data, int length) {
+	assert(length == 4 && !memcmp(data, "ping", 4));
+	echoed++;
+	us_listen_socket_close(0, listen_socket);
+	us_timer_close(deadline);
+	return us_socket_close(0, s, 0, NULL);
+}
+
+struct us_socket_t *on_client_connect_error(struct us_socket_t *s, int code) {
+	failed++;
+	return s;
+}
+
+void on_deadline(struct us_timer_t *t) {
+	fprintf(stderr, "Timed out, opened %d echoed %d failed %d\n", opened, echoed, failed);
+	assert(0);
+}
+
+/* Fast Open connects hold back their SYN only to addresses with a cookie cached. One for 127.0.0.2 comes from a
+ * connection to a listener taking Fast Open there, where the kernel lets servers do that (net.ipv4.tcp_fastopen) */
+void cache_fast_open_cookie() {
+	struct sockaddr_in addr = {.sin_family = AF_INET};
+	socklen_t length = sizeof(addr);
+	inet_pton(AF_INET, "127.0.0.2", &addr.sin_addr);
+	int enabled = 1, queue_length = 16;
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(listener, IPPROTO_TCP, TCP_FASTOPEN, &queue_length, sizeof(queue_length));
+	bind(listener, (struct sockaddr *) &addr, sizeof(addr));
+	listen(listener, 16);
+	getsockname(listener, (struct sockaddr *) &addr, &length);
+
+	int client = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(client, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &enabled, sizeof(enabled));
+	connect(client, (struct sockaddr *) &addr, sizeof(addr));
+	write(client, "x", 1);
+	close(accept(listener, 0, 0));
+	close(client);
+	close(listener);
+}
+
+void race(int connect_options) {
+	opened = echoed = failed = 0;
+	struct us_loop_t *loop = us_create_loop(0, on_wakeup, on_pre, on_post, 0);
+
+	struct us_socket_context_options_t options = {};
+	struct us_socket_context_t *server = us_create_socket_context(0, loop, 0, options);
+	us_socket_context_on_open(0, server, on_server_open);
+	us_socket_context_on_data(0, server, on_server_data);
+	us_socket_context_on_writable(0, server, on_writable);
+	us_socket_context_on_close(0, server, on_close);
+	us_socket_context_on_end(0, server, on_end);
+	us_socket_context_on_timeout(0, server, on_timeout);
+	listen_socket = us_socket_context_listen(0, server, "127.0.0.1", 0, 0, 0);
+	assert(listen_socket);
+	port = us_socket_local_port(0, (struct us_socket_t *) listen_socket);
+
+	/* Same port on 127.0.0.2, never accepting, with its backlog filled so further SYNs are dropped */
+	int blackhole = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+	inet_pton(AF_INET, "127.0.0.2", &addr.sin_addr);
+	assert(!bind(blackhole, (struct sockaddr *) &addr, sizeof(addr)));
+	assert(!listen(blackhole, 0));
+	for (int i = 0; i < 4; i++) {
+		int filler = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		connect(filler, (struct sockaddr *) &addr, sizeof(addr));
+	}
+	usleep(100000);
+
+	struct us_socket_context_t *client = us_create_socket_context(0, loop, 0, options);
+	us_socket_context_on_open(0, client, on_client_open);
+	us_socket_context_on_data(0, client, on_client_data);
+	us_socket_context_on_writable(0, client, on_writable);
+	us_socket_context_on_close(0, client, on_close);
+	us_socket_context_on_end(0, client, on_end);
+	us_socket_context_on_timeout(0, client, on_timeout);
+	us_socket_context_on_connect_error(0, client, on_client_connect_error);
+	assert(us_socket_context_connect(0, client, "race.test", port, NULL, connect_options, 0));
+
+	deadline = us_create_timer(loop, 0, 0);
+	us_timer_set(deadline, on_deadline, 5000, 0);
+
+	us_loop_run(loop);
+
+	assert(opened == 1 && echoed == 1 && !failed);
+
+	us_socket_context_free(0, client);
+	us_socket_context_free(0, server);
+	us_loop_free(loop);
+	close(blackhole);
+}
+
+int main() {
+	cache_fast_open_cookie();
+	race(LIBUS_CONNECT_DEFAULT);
+	race(LIBUS_CONNECT_FAST_OPEN);
+
+	printf("OK\n");
+	return 0;
+}